@@ -71,13 +71,14 @@ void (*fops[])() = { //
 
 struct reloc_s* relocs UDATA; // relocation list root
 int nrelocs UDATA;            // relocation list size
+int pool_bytes UDATA;         // literal pool bytes, with the branches over them
 
 char *p UDATA, *lp UDATA;                       // current position in source code
 char* data UDATA;                               // data/bss pointer
 char* data_base UDATA;                          // data/bss pointer
 int* base_sp UDATA;                             // stack
 uint16_t *e UDATA, *le UDATA, *text_base UDATA; // current position in emitted code
-uint16_t* ecas UDATA;                           // case statement patch-up pointer
+struct patch_s* cases UDATA;                    // case labels of the current switch
 int* ncas UDATA;                                // case statement patch-up pointer
 uint16_t* def UDATA;                            // default statement patch-up pointer
 struct patch_s* brks UDATA;                     // break statement patch-up pointer
@@ -107,6 +108,7 @@ int lineno UDATA;              // current line number
 int src_opt UDATA;             // print source and assembly flag
 int nopeep_opt UDATA;          // turn off peep-hole optimization
 int uchar_opt UDATA;           // use unsigned character variables
+int heap_opt UDATA;            // report the program's heap usage
 int* n UDATA;                         // current position in emitted abstract syntax tree
                                       // With an AST, the compiler is not limited to generate
                                       // code on the fly with parsing.
@@ -123,8 +125,9 @@ int indef UDATA;               // parsing in define statement
 char* src_base UDATA;          // source code region
 
 // symbol table
-struct ident_s* id UDATA;       // currently parsed identifier
-struct ident_s* sym_base UDATA; // symbol table (simple list of identifiers)
+struct ident_s* id UDATA;        // currently parsed identifier
+struct ident_s* sym_base UDATA;  // symbol table (simple list of identifiers)
+struct ident_s** sym_hash UDATA; // symbol table hash buckets
 
 struct member_s** members UDATA; // array (indexed by type) of struct member lists
 
@@ -221,13 +224,22 @@ void __not_in_flash_func(dummy)(void) {
 }
 #endif
 
-// executable file header
-struct exe_s {
-    int entry;  // entry point
-    int tsize;  // text segment size
-    int dsize;  // data segment size
-    int nreloc; // # of external function relocation entries
-};
+// the header of an executable file of len bytes describes segments that fit
+// the code and data segments and the rest of the file. An xmodem transfer
+// pads the file to whole 128 byte blocks
+int cc_exe_valid(const struct exe_s* exe, int len) {
+    int ds = exe->dsize & 0x3fffffff;
+    int entry = exe->entry & ~1;
+    if ((exe->dsize & 0xc0000000) != 0xc0000000 || exe->tsize <= 0 || exe->tsize > TEXT_BYTES ||
+        (exe->tsize & 1) || ds > DATA_BYTES || exe->nreloc < 0 || exe->nreloc > exe->tsize / 2) {
+        return 0;
+    }
+    if (entry < (int)__StackLimit || entry >= (int)__StackLimit + exe->tsize) {
+        return 0;
+    }
+    int need = sizeof(*exe) + exe->tsize + ds + exe->nreloc * sizeof(int);
+    return len >= need && len - need < 128;
+}
 
 // compiler can be invoked in compile mode (mode = 0)
 // or loader mode (mode = 1)
@@ -248,6 +260,11 @@ int cc(int mode, int argc, char** argv) {
 
     // compile mode
     if (mode == 0) {
+        // allocate the symbol table hash buckets
+        sym_hash = cc_malloc(SYM_HASH_BYTES, 1);
+        // index the peep hole patterns by their last opcode
+        peep_init();
+
         // Register keywords in symbol table. Must match the sequence of enum
         p = "enum char int float struct union sizeof return goto break continue "
             "if do while for switch case default else void main";
@@ -309,6 +326,8 @@ int cc(int mode, int argc, char** argv) {
                 }
             } else if ((*argv)[1] == 'u') {
                 uchar_opt = 1;
+            } else if ((*argv)[1] == 'm') {
+                heap_opt = 1;
             } else if ((*argv)[1] == 'D') {
                 p = &(*argv)[2];
                 next();
@@ -420,13 +439,6 @@ int cc(int mode, int argc, char** argv) {
             }
         }
 
-        // free all the compiler buffers
-        cc_free_all();
-        src_base = NULL;
-        ast = NULL;
-        sym_base = NULL;
-        tsize = NULL;
-
         if (src_opt) {
             disasm_cleanup(&state);
         }
@@ -486,14 +498,18 @@ int cc(int mode, int argc, char** argv) {
             if (fs_setattr(full_path(ofn), 1, "exe", 4) < LFS_ERR_OK) {
                 fatal("unable to set executable attribute");
             }
-            printf("\ntext  %06x\ndata  %06x\nentry %06x\nreloc %06x\n", exe.tsize, ds,
-                   exe.entry - (int)text_base, exe.nreloc);
+            printf("\ntext  %06x\ndata  %06x\nentry %06x\nreloc %06x\npool  %06x\n", exe.tsize,
+                   ds, exe.entry - (int)text_base, exe.nreloc, pool_bytes);
+            rslt = 0;
             goto done;
         }
         if (src_opt) {
             goto done;
         }
-
+#if CC_HOST
+        fatal("the host compiler only writes executables, use -o exename");
+    }
+#else
     } else { // loader mode
         // output file name is not optional
         if (argc < 1) {
@@ -521,6 +537,10 @@ int cc(int mode, int argc, char** argv) {
         if ((exe.dsize & 0xc0000000) != 0xc0000000) {
             fatal("executable compiled with earlier version not compatible, please recompile");
         }
+        if (!cc_exe_valid(&exe, fs_file_size(fd))) {
+            fs_file_close(fd);
+            fatal("%s is not a valid executable", ofn);
+        }
         // clear the code segment for good measure though not necessary
         memset(__StackLimit, 0, TEXT_BYTES + DATA_BYTES);
         // read in the code segment
@@ -536,6 +556,7 @@ int cc(int mode, int argc, char** argv) {
             fd = NULL;
             fatal("error reading %s", ofn);
         }
+        data = __StackLimit + TEXT_BYTES + ds;
         // set all the relocatable external function calls
         for (int i = 0; i < exe.nreloc; i++) {
             int addr;
@@ -544,40 +565,57 @@ int cc(int mode, int argc, char** argv) {
                 fd = NULL;
                 fatal("error reading %s", ofn);
             }
-            int v = *((int*)addr);
+            // bit 0 set marks a bl holding the function until its offset is set
+            uint16_t* bl = (uint16_t*)(addr & ~1);
+            int v = (addr & 1) ? (int)(bl[0] | ((uint32_t)bl[1] << 16)) : *((int*)addr);
+            int a;
             if (v < 0) {
-                *((int*)addr) = (int)fops[-v];
+                a = (int)fops[-v];
             } else {
                 if (externs[v].is_printf) {
-                    *((int*)addr) = (int)x_printf;
+                    a = (int)x_printf;
                 } else if (externs[v].is_sprintf) {
-                    *((int*)addr) = (int)x_sprintf;
+                    a = (int)x_sprintf;
                 } else {
-                    *((int*)addr) = (int)externs[v].extrn;
+                    a = (int)externs[v].extrn;
                 }
             }
+            if (!(addr & 1)) {
+                *((int*)addr) = a;
+            } else if (!encode_call(bl, a & ~1, bl)) {
+                fs_file_close(fd);
+                fd = NULL;
+                fatal("%s not compatible with this version, please recompile", ofn);
+            }
         }
         // close the file and free its descriptor
         fs_file_close(fd);
         fd = NULL;
     }
+    // free the compiler buffers
     cc_free_all();
+    // the data segment space past the globals holds the program's small blocks
+    cc_heap_init(data, __StackLimit + TEXT_BYTES + DATA_BYTES);
 
     // launch the user code
     printf("\n");
     asm volatile("mov  %0, sp \n" : "=r"(exit_sp));
-    asm volatile("mov  r0, %2 \n"
-                 "push {r0}   \n"
-                 "mov  r0, %3 \n"
-                 "push {r0}   \n"
+    asm volatile("mov  r0, %2 \n" // argc and argv in r0 and r1, and on the stack
+                 "push {r0}   \n" // for programs built by earlier versions
+                 "mov  r1, %3 \n"
+                 "push {r1}   \n"
                  "blx  %1     \n"
                  "add  sp, #8 \n"
                  "mov  %0, r0 \n"
                  : "=r"(rslt)
                  : "r"(exe.entry | 1), "r"(argc), "r"(argv)
-                 : "r0", "r1", "r2", "r3");
+                 : "r0", "r1", "r2", "r3", "r4", "r5", "r6");
     // display the return code
     printf("\nCC = %d\n", rslt);
+    if (heap_opt) {
+        cc_heap_report();
+    }
+#endif // CC_HOST
 
 done: // clean up and return
     if (fd) {
@@ -15,6 +15,15 @@
 #ifndef _C4_
 #define _C4_
 
+// executable file header
+struct exe_s {
+    int entry;  // entry point
+    int tsize;  // text segment size
+    int dsize;  // data segment size
+    int nreloc; // # of external function relocation entries
+};
+
 int cc(int mode, int argc, char* argv[]);
+int cc_exe_valid(const struct exe_s* exe, int len);
 
 #endif
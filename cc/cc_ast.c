@@ -72,10 +72,11 @@ void ast_CastF(int way, int val) {
     CastF_entry(n).way = way;
 }
 
-uint16_t* ast_Enter(int val) {
+uint16_t* ast_Enter(int val, int parms) {
     push_ast(Enter_words);
     Enter_entry(n).tk = Enter;
     Enter_entry(n).val = val;
+    Enter_entry(n).parms = parms;
 }
 
 // Two word entries
@@ -139,7 +140,7 @@ void ast_Load(int typ) {
 void ast_Begin(int* next) {
     push_ast(Begin_words);
     Begin_entry(n).tk = '{';
-    Begin_entry(n).next = next;
+    Begin_entry(n).next = (int)next;
 }
 
 // Single word entry
@@ -153,3 +154,33 @@ void ast_End(void) {
     push_ast(End_words);
     End_entry(n).tk = ';';
 }
+
+// Expression queries shared by the folder and the code generator
+
+// binary operator, its left operand pointed to by the entry, right operand following it
+int is_binary(int tk) {
+    return (tk >= Or && tk <= Mod) || (tk >= AddF && tk <= LeF);
+}
+
+// expression whose evaluation may change state, an assignment or a call
+int has_side_effects(int* n) {
+    int i = ast_Tk(n);
+    if (is_binary(i) || i == Lor || i == Lan) {
+        return has_side_effects((int*)Oper_entry(n).oprnd) || has_side_effects(n + Oper_words);
+    }
+    switch (i) {
+    case Num:
+    case NumF:
+    case Loc:
+        return 0;
+    case Load:
+        return has_side_effects(n + Load_words);
+    case CastF:
+        return has_side_effects((int*)CastF_entry(n).val);
+    case Cond:
+        return has_side_effects((int*)Cond_entry(n).cond_part) ||
+               has_side_effects((int*)Cond_entry(n).if_part) ||
+               (Cond_entry(n).else_part && has_side_effects((int*)Cond_entry(n).else_part));
+    }
+    return 1;
+}
@@ -122,12 +122,13 @@ void ast_CastF(int way, int val);
 
 typedef struct {
     int tk;
-    int val;
+    int val;   // words of locals
+    int parms; // parameters passed in registers
 } Enter_entry_t;
 
 #define Enter_entry(a) (*((Enter_entry_t*)a))
 #define Enter_words (sizeof(Enter_entry_t) / sizeof(int))
-uint16_t* ast_Enter(int val);
+uint16_t* ast_Enter(int val, int parms);
 
 // Two word entries:
 
@@ -179,7 +180,7 @@ void ast_Load(int typ);
 
 typedef struct {
     int tk;
-    int* next;
+    int next;
 } Begin_entry_t;
 
 #define Begin_entry(a) (*((Begin_entry_t*)a))
@@ -209,4 +210,9 @@ typedef struct {
 #define End_words (sizeof(End_entry_t) / sizeof(int))
 void ast_End(void);
 
+// Expression queries shared by the folder and the code generator
+
+int is_binary(int tk);
+int has_side_effects(int* n);
+
 #endif
@@ -0,0 +1,534 @@
+#include "cc_fold.h"
+#include "cc_internals.h"
+#include "cc_ast.h"
+#include "cc_tokns.h"
+#include "cc_ops.h"
+
+// AST constant folding and algebraic simplification
+//
+// Runs over the AST of a function before code generation. Nodes are rewritten
+// in place: a folded expression returns the node that replaces it, which its
+// parent either links to or, for operands stored inline after the parent
+// entry, copies into the space of the original node.
+
+#define FLOAT_ONE 0x3f800000      // 1.0f
+#define FLOAT_MINUS_ONE 0xbf800000 // -1.0f
+#define FLOAT_SIGN 0x80000000     // -0.0f
+
+static int* fold_expr(int* n);
+static int* fold_oper(int* n);
+
+static float as_float(int v) {
+    return *((float*)&v);
+}
+
+static int float_bits(float f) {
+    return *((int*)&f);
+}
+
+static int span(int* n);
+
+// size of an entry followed by an inline operand, 0 if unknown
+static int span_with(int words, int* n) {
+    int l = span(n);
+    return l ? words + l : 0;
+}
+
+// number of contiguous words used by an expression and its inline operands
+static int span(int* n) {
+    int i = ast_Tk(n);
+    if (is_binary(i) || i == Lor || i == Lan) {
+        return span_with(Oper_words, n + Oper_words);
+    }
+    switch (i) {
+    case Num:
+    case NumF:
+        return Num_words;
+    case Loc:
+        return Double_words;
+    case ';':
+        return End_words;
+    case Load:
+    case Inc:
+    case Dec:
+        return span_with(Load_words, n + Load_words);
+    case '{':
+    case Link:
+        return span_with(Begin_words, n + Begin_words);
+    case Assign:
+        return span_with(Assign_words, n + Assign_words);
+    case CastF:
+        return CastF_words;
+    case Cond:
+        return Cond_words;
+    case While:
+        return While_words;
+    case Func:
+    case Syscall:
+        return Func_words;
+    }
+    return 0;
+}
+
+// statement containing a goto, case or default label, that can't be dropped
+static int has_labels(int* n) {
+    if (n == 0) {
+        return 0;
+    }
+    switch (ast_Tk(n)) {
+    case Label:
+    case Case:
+    case Default:
+        return 1;
+    case '{':
+        return has_labels((int*)Begin_entry(n).next) || has_labels(n + Begin_words);
+    case Cond:
+        return has_labels((int*)Cond_entry(n).if_part) ||
+               has_labels((int*)Cond_entry(n).else_part);
+    case While:
+    case DoWhile:
+        return has_labels((int*)While_entry(n).body);
+    case For:
+        return has_labels((int*)For_entry(n).body);
+    case Switch:
+        return has_labels((int*)Switch_entry(n).cas);
+    }
+    return 0;
+}
+
+// replace n by an integer constant
+static int* set_num(int* n, int v) {
+    Num_entry(n).tk = Num;
+    Num_entry(n).val = v;
+    Num_entry(n).valH = 0;
+    return n;
+}
+
+// replace n by a float constant
+static int* set_numf(int* n, float f) {
+    set_num(n, float_bits(f));
+    Num_entry(n).tk = NumF;
+    return n;
+}
+
+// fold an expression stored inline at n, moving its replacement there
+static void fold_inline(int* n) {
+    int* r = fold_expr(n);
+    if (r == n) {
+        return;
+    }
+    int l = span(r);
+    int k = span(n);
+    if (l && l <= k) {
+        for (int i = 0; i < l; ++i) { // the replacement is always above n
+            n[i] = r[i];
+        }
+        return;
+    }
+    if (k < Begin_words + End_words) {
+        return; // no room for a link, keep the original
+    }
+    Begin_entry(n).tk = Link; // too big, link to it
+    Begin_entry(n).next = (int)r;
+    End_entry(n + Begin_words).tk = ';';
+}
+
+// fold a linked expression or statement
+static int fold_link(int n) {
+    return n ? (int)fold_expr((int*)n) : 0;
+}
+
+// value of integer operation a op b, returns 0 if it can't be computed at compile time
+static int fold_int(int op, int a, int b, int* v) {
+    switch (op) {
+    case Or:
+        *v = a | b;
+        break;
+    case Xor:
+        *v = a ^ b;
+        break;
+    case And:
+        *v = a & b;
+        break;
+    case Eq:
+        *v = a == b;
+        break;
+    case Ne:
+        *v = a != b;
+        break;
+    case Ge:
+        *v = a >= b;
+        break;
+    case Lt:
+        *v = a < b;
+        break;
+    case Gt:
+        *v = a > b;
+        break;
+    case Le:
+        *v = a <= b;
+        break;
+    case Shl:
+    case Shr:
+        if (b < 0 || b > 31) {
+            return 0;
+        }
+        *v = (op == Shl) ? (int)((unsigned)a << b) : a >> b;
+        break;
+    case Add:
+        *v = (unsigned)a + (unsigned)b;
+        break;
+    case Sub:
+        *v = (unsigned)a - (unsigned)b;
+        break;
+    case Mul:
+        *v = (unsigned)a * (unsigned)b;
+        break;
+    case Div:
+    case Mod:
+        if (b == 0 || (a == (int)0x80000000 && b == -1)) {
+            return 0;
+        }
+        *v = (op == Div) ? a / b : a % b;
+        break;
+    default:
+        return 0;
+    }
+    return 1;
+}
+
+// float operation a op b, comparisons give an integer
+static int* fold_float(int* n, int op, int a, int b) {
+    float fa = as_float(a), fb = as_float(b);
+    switch (op) {
+    case AddF:
+        return set_numf(n, fa + fb);
+    case SubF:
+        return set_numf(n, fa - fb);
+    case MulF:
+        return set_numf(n, fa * fb);
+    case DivF:
+        return set_numf(n, fa / fb);
+    case EqF:
+        return set_num(n, a == b); // generated code compares the bits
+    case NeF:
+        return set_num(n, a != b);
+    case GeF:
+        return set_num(n, fa >= fb);
+    case LtF:
+        return set_num(n, fa < fb);
+    case GtF:
+        return set_num(n, fa > fb);
+    case LeF:
+        return set_num(n, fa <= fb);
+    }
+    return n;
+}
+
+// fold x op c1 op c2 to x op (c1 op c2), l is the left operand of n
+static int reassociate(int* n, int* l) {
+    int i = ast_Tk(n), j = ast_Tk(l), c;
+    int* r = n + Oper_words;
+    int* ll = (int*)Oper_entry(l).oprnd;
+    int* lr = l + Oper_words;
+    int* x;
+    unsigned u; // wraps like the target
+    if (i == Add || i == Sub) {
+        if (j != Add && j != Sub) {
+            return 0;
+        }
+        u = (i == Add) ? (unsigned)Num_entry(r).val : -(unsigned)Num_entry(r).val;
+        if (ast_Tk(lr) == Num) {
+            u += (j == Add) ? (unsigned)Num_entry(lr).val : -(unsigned)Num_entry(lr).val;
+            x = ll;
+        } else if (j == Add && ast_Tk(ll) == Num) {
+            u += (unsigned)Num_entry(ll).val;
+            x = lr;
+        } else {
+            return 0;
+        }
+        c = (int)u;
+        Oper_entry(n).tk = Add;
+    } else if (i == Mul || i == And || i == Or || i == Xor) {
+        if (j != i) {
+            return 0;
+        }
+        if (ast_Tk(lr) == Num) {
+            fold_int(i, Num_entry(lr).val, Num_entry(r).val, &c);
+            x = ll;
+        } else if (ast_Tk(ll) == Num) {
+            fold_int(i, Num_entry(ll).val, Num_entry(r).val, &c);
+            x = lr;
+        } else {
+            return 0;
+        }
+    } else if (i == Shl || i == Shr) {
+        if (j != i || ast_Tk(lr) != Num) {
+            return 0;
+        }
+        if ((unsigned)Num_entry(lr).val > 31 || (unsigned)Num_entry(r).val > 31) {
+            return 0;
+        }
+        c = Num_entry(lr).val + Num_entry(r).val;
+        if (c > 31) {
+            return 0;
+        }
+        x = ll;
+    } else {
+        return 0;
+    }
+    Oper_entry(n).oprnd = (int)x;
+    Num_entry(r).val = c;
+    return 1;
+}
+
+// integer operation with a constant right operand
+static int* fold_right(int* n, int* l, int c) {
+    int i = ast_Tk(n);
+    int v;
+    if (ast_Tk(l) == i || ast_Tk(l) == Add || ast_Tk(l) == Sub) {
+        if (reassociate(n, l)) {
+            return fold_oper(n);
+        }
+    }
+    switch (i) {
+    case Add:
+        // address of an element of a local array or struct
+        v = Num_entry(l).val + c / 4;
+        if (ast_Tk(l) == Loc && (c & 3) == 0 &&
+            ((Num_entry(l).val <= 0 && v <= 0) || (Num_entry(l).val > 0 && v > 0))) {
+            Double_entry(n).tk = Loc;
+            Double_entry(n).v1 = v;
+            return n;
+        }
+        // fall through
+    case Sub:
+    case Or:
+    case Xor:
+    case Shl:
+    case Shr:
+        return (c == 0) ? l : n;
+    case Mul:
+        if (c == 0 && !has_side_effects(l)) {
+            return set_num(n, 0);
+        }
+        // fall through
+    case Div:
+        return (c == 1) ? l : n;
+    case And:
+        if (c == 0 && !has_side_effects(l)) {
+            return set_num(n, 0);
+        }
+        return (c == -1) ? l : n;
+    }
+    return n;
+}
+
+// commutative integer operation with a constant left operand
+static int* fold_left(int* n, int c) {
+    int* r = n + Oper_words;
+    switch (ast_Tk(n)) {
+    case Add:
+    case Or:
+    case Xor:
+        return (c == 0) ? r : n;
+    case Mul:
+        if (c == 0 && !has_side_effects(r)) {
+            return set_num(n, 0);
+        }
+        return (c == 1) ? r : n;
+    case And:
+        if (c == 0 && !has_side_effects(r)) {
+            return set_num(n, 0);
+        }
+        return (c == -1) ? r : n;
+    }
+    return n;
+}
+
+// float operation with a constant right operand
+static int* fold_float_right(int* n, int* l, int c) {
+    int* r = n + Oper_words;
+    switch (ast_Tk(n)) {
+    case AddF:
+        return (c == FLOAT_SIGN) ? l : n; // x + -0.0
+    case SubF:
+        return (c == 0) ? l : n;
+    case MulF:
+        if (c == FLOAT_MINUS_ONE) { // negation, flip the sign bit
+            Oper_entry(n).tk = Xor;
+            set_num(r, FLOAT_SIGN);
+            return n;
+        }
+        // fall through
+    case DivF:
+        if (c == FLOAT_ONE) {
+            return l;
+        }
+        // division by a power of two, multiply by its exact reciprocal
+        if (ast_Tk(n) == DivF && (c & 0x7fffff) == 0 && ((c >> 23) & 0xff) > 1 &&
+            ((c >> 23) & 0xff) < 253) {
+            Oper_entry(n).tk = MulF;
+            set_numf(r, 1.0f / as_float(c));
+        }
+        return n;
+    }
+    return n;
+}
+
+static int* fold_oper(int* n) {
+    int i = ast_Tk(n), v;
+    int* l = (int*)Oper_entry(n).oprnd;
+    int* r = n + Oper_words;
+    if (i >= AddF) {
+        if (ast_Tk(l) == NumF && ast_Tk(r) == NumF) {
+            return fold_float(n, i, Num_entry(l).val, Num_entry(r).val);
+        }
+        if (ast_Tk(r) == NumF) {
+            return fold_float_right(n, l, Num_entry(r).val);
+        }
+        if (i == MulF && ast_Tk(l) == NumF && Num_entry(l).val == FLOAT_ONE) {
+            return r;
+        }
+        return n;
+    }
+    if (ast_Tk(l) == Num && ast_Tk(r) == Num) {
+        if (fold_int(i, Num_entry(l).val, Num_entry(r).val, &v)) {
+            return set_num(n, v);
+        }
+        return n;
+    }
+    if (ast_Tk(r) == Num) {
+        return fold_right(n, l, Num_entry(r).val);
+    }
+    if (ast_Tk(l) == Num) {
+        return fold_left(n, Num_entry(l).val);
+    }
+    return n;
+}
+
+static int* fold_expr(int* n) {
+    int i = ast_Tk(n), t;
+    int *a, *b;
+    if (is_binary(i)) {
+        Oper_entry(n).oprnd = (int)fold_expr((int*)Oper_entry(n).oprnd);
+        fold_inline(n + Oper_words);
+        return fold_oper(n);
+    }
+    switch (i) {
+    case Lor:
+    case Lan:
+        Oper_entry(n).oprnd = (int)fold_expr((int*)Oper_entry(n).oprnd);
+        fold_inline(n + Oper_words);
+        a = (int*)Oper_entry(n).oprnd;
+        if (ast_Tk(a) == Num && (Num_entry(a).val != 0) == (i == Lor)) {
+            return set_num(n, i == Lor); // short circuit
+        }
+        break;
+    case Load:
+    case Inc:
+    case Dec:
+        fold_inline(n + Load_words);
+        break;
+    case '{':
+    case Link:
+        Begin_entry(n).next = fold_link(Begin_entry(n).next);
+        fold_inline(n + Begin_words);
+        break;
+    case Assign:
+        Assign_entry(n).right_part = fold_link(Assign_entry(n).right_part);
+        fold_inline(n + Assign_words);
+        // convert a constant assigned to a variable of the other type
+        a = n + Assign_words;
+        t = Assign_entry(n).type;
+        if ((t >> 16) == INT && (t & 0xffff) == FLOAT && ast_Tk(a) == Num) {
+            set_numf(a, (float)Num_entry(a).val);
+            Assign_entry(n).type = (FLOAT << 16) | FLOAT;
+        } else if ((t >> 16) == FLOAT && (t & 0xffff) == INT && ast_Tk(a) == NumF &&
+                   as_float(Num_entry(a).val) > -2147483648.0f &&
+                   as_float(Num_entry(a).val) < 2147483648.0f) {
+            set_num(a, (int)as_float(Num_entry(a).val));
+            Assign_entry(n).type = (INT << 16) | INT;
+        }
+        break;
+    case CastF:
+        CastF_entry(n).val = fold_link(CastF_entry(n).val);
+        a = (int*)CastF_entry(n).val;
+        if (CastF_entry(n).way == ITOF && ast_Tk(a) == Num) {
+            return set_numf(n, (float)Num_entry(a).val);
+        }
+        if (CastF_entry(n).way == FTOI && ast_Tk(a) == NumF &&
+            as_float(Num_entry(a).val) > -2147483648.0f &&
+            as_float(Num_entry(a).val) < 2147483648.0f) {
+            return set_num(n, (int)as_float(Num_entry(a).val));
+        }
+        break;
+    case Cond:
+        Cond_entry(n).cond_part = fold_link(Cond_entry(n).cond_part);
+        Cond_entry(n).if_part = fold_link(Cond_entry(n).if_part);
+        Cond_entry(n).else_part = fold_link(Cond_entry(n).else_part);
+        a = (int*)Cond_entry(n).cond_part;
+        if (ast_Tk(a) != Num) {
+            break;
+        }
+        // constant condition, drop the branch not taken
+        if (Num_entry(a).val) {
+            a = (int*)Cond_entry(n).if_part;
+            b = (int*)Cond_entry(n).else_part;
+        } else {
+            a = (int*)Cond_entry(n).else_part;
+            b = (int*)Cond_entry(n).if_part;
+        }
+        if (has_labels(b)) {
+            break;
+        }
+        if (a == 0) {
+            End_entry(n).tk = ';';
+            return n;
+        }
+        return a;
+    case While:
+        While_entry(n).body = fold_link(While_entry(n).body);
+        While_entry(n).cond = fold_link(While_entry(n).cond);
+        a = (int*)While_entry(n).cond;
+        if (ast_Tk(a) == Num && Num_entry(a).val == 0 && !has_labels((int*)While_entry(n).body)) {
+            End_entry(n).tk = ';';
+        }
+        break;
+    case DoWhile:
+        While_entry(n).body = fold_link(While_entry(n).body);
+        While_entry(n).cond = fold_link(While_entry(n).cond);
+        break;
+    case For:
+        For_entry(n).init = fold_link(For_entry(n).init);
+        For_entry(n).cond = fold_link(For_entry(n).cond);
+        For_entry(n).incr = fold_link(For_entry(n).incr);
+        For_entry(n).body = fold_link(For_entry(n).body);
+        break;
+    case Switch:
+        Switch_entry(n).cond = fold_link(Switch_entry(n).cond);
+        Switch_entry(n).cas = fold_link(Switch_entry(n).cas);
+        break;
+    case Case:
+        Case_entry(n).expr = fold_link(Case_entry(n).expr);
+        break;
+    case Default:
+    case Return:
+        Double_entry(n).v1 = fold_link(Double_entry(n).v1);
+        break;
+    case Func:
+    case Syscall:
+        for (a = (int*)Func_entry(n).next; a; a = (int*)ast_Tk(a)) {
+            fold_inline(a + 1);
+        }
+        break;
+    case Enter:
+        fold_inline(n + Enter_words);
+        break;
+    }
+    return n;
+}
+
+void fold(int* n) {
+    fold_expr(n);
+}
@@ -0,0 +1,6 @@
+#ifndef _CC_FOLD_H_
+#define _CC_FOLD_H_
+
+void fold(int* n);
+
+#endif
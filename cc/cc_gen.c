@@ -34,11 +34,19 @@ void emit_word(uint32_t n) {
     ++e;
 }
 
+// emit a halfword of data, out of the peephole optimizer's sight
+static void emit_half(uint16_t n) {
+    if (e >= text_base + (TEXT_BYTES / sizeof(*e)) - 1) {
+        fatal("code segment exceeded, program is too big");
+    }
+    *++e = n;
+}
+
 static void emit_load_long_imm(int r, int val, int ext) {
     emit(0x4800 | (r << 8)); // ldr rr,[pc + offset n]
     struct patch_s* p = pcrel;
     while (p) {
-        if (p->val == val) {
+        if (p->val == val && p->ext == ext) {
             break;
         }
         p = p->next;
@@ -67,7 +75,11 @@ static void emit_load_long_imm(int r, int val, int ext) {
     p->locs = pl;
 }
 
+static int const_reg(int val);
+static void emit_mov(int rd, int rm);
+
 static void emit_load_immediate(int r, int val) {
+    int rc;
     if (val >= 0 && val < 256) {       //
         emit(0x2000 | val | (r << 8)); // movs rr, #n
         return;
@@ -77,17 +89,47 @@ static void emit_load_immediate(int r, int val) {
         emit(0x4240 | (r << 3) | r);    // negs rr, rr
         return;
     }
+    if ((rc = const_reg(val)) != 0) {
+        emit_mov(r, rc);
+        return;
+    }
     emit_load_long_imm(r, val, 0);
 }
 
+// literal pools
+//
+// The constants loaded pc relative are placed in a pool after the function,
+// or ahead of the code to come once the first pending load is about to lose
+// reach of it. Code not falling through, after a jump or a return, takes the
+// pool without a branch around it when the pending loads are nearly out of
+// reach and the rest of the function would take them out of it, and a loop
+// that could take them out of reach gets the pool ahead of it, so that no loop
+// branches around one. The code still to come in the function is estimated
+// at two bytes for three AST words, those between the node generated and the
+// Enter node, and the code of a loop more safely at a byte per word.
+
+#define POOL_REACH 1000 // bytes from a pending load to the end of its pool
+#define POOL_SPOT 850   // bytes worth placing the pool where the code doesn't fall through
+
+static uint16_t* pool_spot UDATA; // end of the last jump or return
+static int* gen_at UDATA;         // node generated last
+static int* gen_enter UDATA;      // Enter node of the function
+
+// bytes from the first pending load to the end of the pool placed here
+static int pool_span(void) {
+    return pcrel_1st ? (int)e + 4 * pcrel_count - (int)pcrel_1st : 0;
+}
+
 static void patch_pc_relative(int brnch) {
+    uint16_t* start = e;
     int rel_count = pcrel_count;
+    int pad = (int)e & 2; // the branch ends a word, the pool needs a nop to be aligned
     pcrel_count = 0;
     if (brnch) {
-        if ((int)e & 2) {
+        emit_branch(e + 2 * rel_count + (pad ? 1 : 0));
+        if (pad) {
             emit(0x46c0); // nop ; (mov r8, r8)
         }
-        emit_branch(e + 2 * rel_count);
     } else {
         if (!((int)e & 2)) {
             emit(0x46c0); // nop ; (mov r8, r8)
@@ -125,40 +167,632 @@ static void patch_pc_relative(int brnch) {
         cc_free(p);
     }
     pcrel_1st = 0;
+    pool_bytes += (e - start) * sizeof(*e);
+    peep_barrier(); // the pool is data, not instructions to rewrite
 }
 
 void check_pc_relative(void) {
-    if (pcrel_1st == 0) {
+    if (pool_span() > POOL_REACH) {
+        patch_pc_relative(1);
+    }
+}
+
+// place the pending pool here when the code just emitted doesn't fall through,
+// nothing branches here yet and the loads are far enough from it not to reach
+// the end of the function
+static void place_pool(void) {
+    int k = (gen_at > gen_enter) ? (gen_at - gen_enter) * 2 / 3 : 0;
+    if (e == pool_spot && !peep_fenced() && pool_span() > POOL_SPOT &&
+        pool_span() + k > POOL_REACH) {
+        patch_pc_relative(0);
+    }
+}
+
+// place the pending pool ahead of a loop spanning the AST from n to "last"
+// when the code of the loop could take the loads out of reach. A loop too big
+// for that gets a pool inside anyway
+static void pool_before_loop(int* n, int* last) {
+    int k = last - n;
+    if (pool_span() && k < POOL_REACH && pool_span() + k > POOL_REACH) {
+        patch_pc_relative(e != pool_spot || peep_fenced());
+    } else {
+        place_pool();
+    }
+}
+
+// expression temporaries
+//
+// A binary operator holds its first evaluated operand in a temporary register
+// while the other operand is computed into r0. Scratch registers r1-r2 are used
+// when evaluation of the second operand doesn't touch them, callee saved
+// registers r4-r6 otherwise, and the stack only when those run out.
+
+#define SCRATCH_REGS ((1 << 1) | (1 << 2) | (1 << 3))
+
+static int temps_live UDATA;  // registers holding pending operands
+static int temps_saved UDATA; // number of callee saved registers used as temporaries
+
+// register variables
+//
+// The parser lists the scalar int, float and pointer variables of a function.
+// Those whose address is never taken are weighted by their uses, ten times
+// more inside loops, and the heaviest get r4-r6 for the whole function ahead of
+// the temporaries. A parameter passed in a register is moved there on entry.
+
+#define VARS_MAX 32 // candidates considered per function
+
+static int var_slot[VARS_MAX] UDATA; // frame slot of each candidate
+static int var_uses[VARS_MAX] UDATA; // weighted uses, -1 once its address is taken
+static int var_regs[VARS_MAX] UDATA; // register assigned, 0 if none
+static int nvars UDATA;              // candidates listed
+static int vars_saved UDATA;         // callee saved registers given to variables
+static int compound_reg UDATA;       // register variable updated by a compound assignment
+
+// a scalar variable at frame slot n may be kept in a register
+void gen_var(int n) {
+    if (nvars < VARS_MAX) {
+        var_slot[nvars++] = n;
+    }
+}
+
+// candidate index of the variable at frame slot n, -1 if not listed
+static int var_index(int n) {
+    for (int i = 0; i < nvars; ++i) {
+        if (var_slot[i] == n) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// register holding the variable addressed by n, 0 if it lives in memory
+static int var_reg(int* n) {
+    int i;
+    if (ast_Tk(n) != Loc || (i = var_index(Num_entry(n).val)) < 0) {
+        return 0;
+    }
+    return var_regs[i];
+}
+
+// common subexpressions
+//
+// Value numbering over the straight line code between branch targets: a pure
+// expression computed again while its operands are unchanged is moved from the
+// callee saved register that kept it. A scan ahead of the code numbers the
+// expressions in the order gen meets them and weighs the instructions repeats
+// would save, ten times more inside loops. A store to a register variable ends
+// the values reading it, any other store or a call those loading from memory,
+// and a branch target all of them.
+
+#define CSE_MAX 16 // values numbered per function
+#define CSE_MEM 1  // value bit in cse_reads, loads from memory
+
+static int* cse_expr[CSE_MAX] UDATA;    // first instance of each value
+static int cse_reads[CSE_MAX] UDATA;    // register variables read as 1 << r, CSE_MEM
+static int cse_gain[CSE_MAX] UDATA;     // weighted instructions saved
+static int cse_regs[CSE_MAX] UDATA;     // register assigned, 0 if none
+static uint16_t* cse_at[CSE_MAX] UDATA; // move to the register, 0 if it doesn't hold the value
+static int ncse UDATA;                  // values numbered
+static int cse_avail UDATA;             // values the scan finds computed, 1 << index
+static int cse_saved UDATA;             // callee saved registers given to values
+
+static int is_leaf(int* n);
+
+// expression computed without side effects from variables, memory and constants
+static int cse_pure(int* n) {
+    int i = ast_Tk(n), t;
+    if (is_binary(i)) {
+        return cse_pure((int*)Oper_entry(n).oprnd) && cse_pure(n + Oper_words);
+    }
+    switch (i) {
+    case Num:
+    case NumF:
+    case Loc:
+        return 1;
+    case Load:
+        t = Load_entry(n).typ;
+        return (t <= ATOM_TYPE || t >= PTR) && cse_pure(n + Load_words);
+    case CastF:
+        return cse_pure((int*)CastF_entry(n).val);
+    }
+    return 0;
+}
+
+// pure expressions a and b compute the same value
+static int same_expr(int* a, int* b) {
+    int i = ast_Tk(a);
+    if (i != ast_Tk(b)) {
+        return 0;
+    }
+    if (is_binary(i)) {
+        return same_expr((int*)Oper_entry(a).oprnd, (int*)Oper_entry(b).oprnd) &&
+               same_expr(a + Oper_words, b + Oper_words);
+    }
+    switch (i) {
+    case Num:
+    case NumF:
+    case Loc:
+        return Num_entry(a).val == Num_entry(b).val;
+    case Load:
+        return Load_entry(a).typ == Load_entry(b).typ && same_expr(a + Load_words, b + Load_words);
+    case CastF:
+        return CastF_entry(a).way == CastF_entry(b).way &&
+               same_expr((int*)CastF_entry(a).val, (int*)CastF_entry(b).val);
+    }
+    return 0;
+}
+
+// instructions computing pure expression n, roughly
+static int cse_cost(int* n) {
+    int i = ast_Tk(n), v;
+    if (is_binary(i)) {
+        v = (i >= Div) ? 4 : 1; // helper calls
+        return v + cse_cost((int*)Oper_entry(n).oprnd) + cse_cost(n + Oper_words);
+    }
+    switch (i) {
+    case Num:
+    case NumF:
+        v = Num_entry(n).val;
+        return (v >= 0 && v < 256) ? 1 : 2;
+    case Loc:
+        return 2;
+    case Load:
+        if (var_reg(n + Load_words)) {
+            return 0; // operations read the register
+        }
+        if (ast_Tk(n + Load_words) == Loc) {
+            return 1;
+        }
+        return 1 + cse_cost(n + Load_words);
+    case CastF:
+        return 3 + cse_cost((int*)CastF_entry(n).val);
+    }
+    return 0;
+}
+
+// register variables and memory pure expression n reads, as for cse_reads
+static int cse_inputs(int* n) {
+    int i = ast_Tk(n), j;
+    if (is_binary(i)) {
+        return cse_inputs((int*)Oper_entry(n).oprnd) | cse_inputs(n + Oper_words);
+    }
+    switch (i) {
+    case Load:
+        if ((j = var_reg(n + Load_words)) != 0) {
+            return 1 << j;
+        }
+        return CSE_MEM | cse_inputs(n + Load_words);
+    case CastF:
+        return cse_inputs((int*)CastF_entry(n).val);
+    }
+    return 0;
+}
+
+// value number of expression n, a new one when "add" is set, -1 if it isn't
+// worth keeping
+static int cse_number(int* n, int add) {
+    int c;
+    for (c = 0; c < ncse; ++c) {
+        if ((add || cse_regs[c]) && same_expr(cse_expr[c], n)) {
+            return c;
+        }
+    }
+    if (!add || ncse == CSE_MAX || is_leaf(n) || !cse_pure(n) || cse_cost(n) < 3) {
+        return -1;
+    }
+    cse_expr[ncse] = n;
+    cse_reads[ncse] = cse_inputs(n);
+    cse_gain[ncse] = 0;
+    cse_regs[ncse] = 0;
+    cse_at[ncse] = 0;
+    return ncse++;
+}
+
+// values ended by a store to the variable addressed by n, or by a call when n is 0
+static int cse_ended(int* n) {
+    int j = n ? var_reg(n) : 0, k = 0;
+    for (int c = 0; c < ncse; ++c) {
+        if (cse_reads[c] & (j ? 1 << j : CSE_MEM)) {
+            k |= 1 << c;
+        }
+    }
+    return k;
+}
+
+// values ended by the store or call n, 0 if it is neither
+static int cse_killed(int* n) {
+    switch (ast_Tk(n)) {
+    case Assign:
+        return cse_ended((int*)Assign_entry(n).right_part);
+    case Inc:
+    case Dec:
+        return cse_ended(n + Oper_words);
+    case Func:
+    case Syscall:
+        return cse_ended(0);
+    }
+    return 0;
+}
+
+// number the values of n computed and weigh their repeats, w per instruction
+static void cse_scan(int* n, int w) {
+    int i, c;
+    int* l;
+    if (n == 0) {
         return;
     }
-    int te = (int)e + 4 * pcrel_count;
-    int ta = (int)pcrel_1st;
-    if ((te - ta) > 1000) {
-        patch_pc_relative(1);
+    i = ast_Tk(n);
+    if ((c = cse_number(n, 1)) >= 0) {
+        if (cse_avail & (1 << c)) {
+            cse_gain[c] += w * (cse_cost(n) - 1);
+            return;
+        }
+        cse_gain[c] -= w; // the move keeping it
+    }
+    if (is_binary(i) || i == Lor || i == Lan) {
+        cse_scan((int*)Oper_entry(n).oprnd, w);
+        cse_scan(n + Oper_words, w);
+        if (i == Lor || i == Lan) {
+            cse_avail = 0;
+        }
+    } else {
+        switch (i) {
+        case Load:
+            cse_scan(n + Load_words, w);
+            break;
+        case Inc:
+        case Dec:
+            cse_scan(n + Oper_words, w);
+            break;
+        case CastF:
+            cse_scan((int*)CastF_entry(n).val, w);
+            break;
+        case '{':
+        case Link:
+            cse_scan((int*)Begin_entry(n).next, w);
+            cse_scan(n + Begin_words, w);
+            break;
+        case Assign:
+            cse_scan((int*)Assign_entry(n).right_part, w);
+            cse_scan(n + Assign_words, w);
+            break;
+        case Cond:
+            cse_scan((int*)Cond_entry(n).cond_part, w);
+            cse_scan((int*)Cond_entry(n).if_part, w);
+            cse_avail = 0;
+            cse_scan((int*)Cond_entry(n).else_part, w);
+            cse_avail = 0;
+            break;
+        case Func:
+        case Syscall:
+            for (l = (int*)Func_entry(n).next; l; l = (int*)ast_Tk(l)) {
+                cse_scan(l + 1, w);
+            }
+            break;
+        case While:
+        case DoWhile:
+            cse_avail = 0;
+            w = (w < 10000) ? w * 10 : w;
+            cse_scan((int*)While_entry(n).body, w);
+            cse_scan((int*)While_entry(n).cond, w);
+            cse_avail = 0;
+            break;
+        case For:
+            cse_scan((int*)For_entry(n).init, w);
+            cse_avail = 0;
+            w = (w < 10000) ? w * 10 : w;
+            cse_scan((int*)For_entry(n).body, w);
+            cse_scan((int*)For_entry(n).incr, w);
+            cse_scan((int*)For_entry(n).cond, w);
+            cse_avail = 0;
+            break;
+        case Switch:
+            cse_scan((int*)Switch_entry(n).cond, w);
+            cse_avail = 0;
+            cse_scan((int*)Switch_entry(n).cas, w);
+            cse_avail = 0;
+            break;
+        case Case:
+            cse_avail = 0;
+            cse_scan((int*)Case_entry(n).expr, w);
+            break;
+        case Default:
+            cse_avail = 0;
+            cse_scan((int*)Num_entry(n).val, w);
+            break;
+        case Return:
+            cse_scan((int*)Num_entry(n).val, w);
+            cse_avail = 0;
+            break;
+        case Label:
+        case Goto:
+        case Break:
+        case Continue:
+            cse_avail = 0;
+            break;
+        }
+    }
+    cse_avail &= ~cse_killed(n);
+    if (c >= 0) {
+        cse_avail |= 1 << c;
+    }
+}
+
+// most profitable value not given a register yet, -1 if none saves anything
+static int cse_best(void) {
+    int best = -1;
+    for (int c = 0; c < ncse; ++c) {
+        if (!cse_regs[c] && cse_gain[c] > 1 && (best < 0 || cse_gain[c] > cse_gain[best])) {
+            best = c;
+        }
+    }
+    return best;
+}
+
+// register holding value c computed earlier on every path to here, 0 if none
+static int cse_held(int c) {
+    uint16_t* at = cse_at[c];
+    if (at == 0 || at > e || *at != (0x4600 | cse_regs[c]) || peep_fenced_since(at)) {
+        return 0;
+    }
+    return cse_regs[c];
+}
+
+// forget the values ended by the store or call n
+static void cse_kill(int* n) {
+    int k = cse_killed(n);
+    for (int c = 0; k; ++c, k >>= 1) {
+        if (k & 1) {
+            cse_at[c] = 0;
+        }
+    }
+}
+
+// data base register
+//
+// Globals are addressed from a callee saved register loaded on entry with the
+// address of one of them, when the loads and stores reaching the others with
+// an immediate offset, up to 124 bytes for words and 31 for characters,
+// outweigh the literal pool loads of their addresses.
+
+#define GLOS_MAX 16 // globals considered per function
+
+static int glo_addr[GLOS_MAX] UDATA; // address of each global loaded or stored
+static int glo_size[GLOS_MAX] UDATA; // bytes accessed, 1 or 4
+static int glo_uses[GLOS_MAX] UDATA; // weighted loads and stores
+static int nglos UDATA;              // globals listed
+static int glo_base UDATA;           // address held by the register
+static int glo_reg UDATA;            // register holding it, 0 if none
+
+// a load or store of "size" bytes at address a, weighing w
+static void glo_use(int a, int size, int w) {
+    int i;
+    if (a < (int)data_base || a >= (int)(data_base + DATA_BYTES)) {
+        return;
+    }
+    for (i = 0; i < nglos && (glo_addr[i] != a || glo_size[i] != size); ++i) {
+    }
+    if (i == nglos) {
+        if (nglos == GLOS_MAX) {
+            return;
+        }
+        glo_addr[nglos] = a;
+        glo_size[nglos] = size;
+        glo_uses[nglos++] = 0;
+    }
+    glo_uses[i] += w;
+}
+
+// offset of address a from base b if an access of "size" bytes can encode it, -1 if not
+static int glo_reach(int b, int a, int size) {
+    int v = a - b;
+    return (v >= 0 && v % size == 0 && v < 32 * size) ? v : -1;
+}
+
+// choose the base reaching the heaviest uses, returns their weight
+static int glo_pick(void) {
+    int best = 0, b, k;
+    for (int i = 0; i < nglos; ++i) {
+        b = glo_addr[i] & ~3;
+        k = 0;
+        for (int j = 0; j < nglos; ++j) {
+            if (glo_reach(b, glo_addr[j], glo_size[j]) >= 0) {
+                k += glo_uses[j];
+            }
+        }
+        if (k > best) {
+            best = k;
+            glo_base = b;
+        }
+    }
+    return best;
+}
+
+// loop invariant constants
+//
+// Constants used inside loops that need a literal pool load, addresses of
+// globals mostly, are hoisted to the function entry into the callee saved
+// registers left over by the variables and temporaries.
+
+#define CONSTS_MAX 8 // candidates considered per function
+
+static int const_vals[CONSTS_MAX] UDATA; // value of each candidate
+static int const_uses[CONSTS_MAX] UDATA; // weighted uses inside loops
+static int const_regs[CONSTS_MAX] UDATA; // register assigned, 0 if none
+static int nconsts UDATA;                // candidates listed
+static int consts_saved UDATA;           // callee saved registers given to constants
+static int consts_live UDATA;            // the registers hold their constants
+
+// register holding constant val, 0 if none
+static int const_reg(int val) {
+    if (!consts_live) {
+        return 0;
     }
+    for (int i = 0; i < nconsts; ++i) {
+        if (const_regs[i] && const_vals[i] == val) {
+            return const_regs[i];
+        }
+    }
+    return 0;
+}
+
+// a use of constant val inside a loop, weighing w
+static void const_use(int val, int w) {
+    int i;
+    if (val > -256 && val < 256) {
+        return; // movs and negs
+    }
+    for (i = 0; i < nconsts && const_vals[i] != val; ++i) {
+    }
+    if (i == nconsts) {
+        if (nconsts == CONSTS_MAX) {
+            return;
+        }
+        const_vals[nconsts] = val;
+        const_uses[nconsts] = 0;
+        const_regs[nconsts++] = 0;
+    }
+    const_uses[i] += w;
+}
+
+// callee saved registers given to variables, temporaries, values, constants
+// and the data base
+static int saved_count(void) {
+    return vars_saved + temps_saved + cse_saved + consts_saved + (glo_reg != 0);
+}
+
+// give the most used constants, the most profitable values of function n and
+// the data base the callee saved registers still free
+static void alloc_consts(int* n) {
+    int best, c, g = glo_pick();
+    ncse = cse_avail = 0;
+    cse_scan(n + Enter_words, 1);
+    cse_saved = consts_saved = glo_reg = 0;
+    while (saved_count() < 3) {
+        best = -1;
+        for (int i = 0; i < nconsts; ++i) {
+            if (!const_regs[i] && (best < 0 || const_uses[i] > const_uses[best])) {
+                best = i;
+            }
+        }
+        c = cse_best();
+        if (!glo_reg && g > 2 && (best < 0 || g >= const_uses[best]) &&
+            (c < 0 || g >= cse_gain[c])) {
+            glo_reg = 4 + saved_count();
+        } else if (c >= 0 && (best < 0 || cse_gain[c] > const_uses[best])) {
+            cse_regs[c] = 4 + saved_count();
+            ++cse_saved;
+        } else if (best >= 0) {
+            const_regs[best] = 4 + saved_count();
+            ++consts_saved;
+        } else {
+            break;
+        }
+    }
+}
+
+// callee saved registers pushed on entry, r4-r6 as a register list
+static int saved_regs(void) {
+    return ((1 << saved_count()) - 1) << 4;
 }
 
+// function frames
+//
+// A function addressing locals or parameters saves r7 and lr, pushes the
+// parameters passed in r0-r3 and points r7 at them, its locals lie below r7.
+// Without them only lr and the callee saved temporaries are pushed, and a
+// function that neither calls nor jumps with a bl keeps lr in place and
+// returns with bx lr.
+
+#define FRAME_LR 1  // lr saved, returns with pop {pc}
+#define FRAME_PTR 2 // r7 saved and set to the frame
+
+static int frame_kind UDATA;  // FRAME_* parts of the current function's frame
+static int frame_parms UDATA; // parameters passed in registers and pushed on entry
+
+// n words of locals
 static void emit_enter(int n) {
-    emit(0xb580);             // push {r7,lr}
-    emit(0x466f);             // mov  r7, sp
-    if (n) {                  //
-        if (n < 128) {        //
-            emit(0xb080 | n); // sub  sp, #n
-        } else {              //
-            emit_load_immediate(3, -n * 4);
-            emit(0x449d); // add sp, r3
+    int regs = saved_regs();
+    if (!(frame_kind & FRAME_PTR)) {
+        if (frame_kind & FRAME_LR) {
+            emit(0xb500 | regs); // push {r4-r6,lr}
+        }
+    } else {
+        emit(0xb580 | regs); // push {r4-r6,r7,lr}
+        if (frame_parms) {
+            emit(0xb400 | ((1 << frame_parms) - 1)); // push {r0-r3}
+        }
+        emit(0x466f); // mov  r7, sp
+        if (n) {
+            if (n < 128) {
+                emit(0xb080 | n); // sub  sp, #n
+            } else {
+                emit_load_immediate(3, -n * 4);
+                emit(0x449d); // add sp, r3
+            }
+        }
+    }
+    for (int i = 0; i < nvars; ++i) { // parameters kept in registers
+        if (var_regs[i] && var_slot[i] >= 0) {
+            emit_mov(var_regs[i], var_slot[i]);
+        }
+    }
+    for (int i = 0; i < nconsts; ++i) {
+        if (const_regs[i]) {
+            emit_load_long_imm(const_regs[i], const_vals[i], 0);
         }
     }
+    if (glo_reg) {
+        emit_load_long_imm(glo_reg, glo_base, 0);
+    }
+    consts_live = 1;
 }
 
 static void emit_leave(void) {
+    int regs = saved_regs();
+    if (!(frame_kind & FRAME_PTR)) {
+        if (frame_kind & FRAME_LR) {
+            emit(0xbd00 | regs); // pop {r4-r6,pc}
+        } else {
+            emit(0x4770); // bx lr
+        }
+        return;
+    }
     emit(0x46bd); // mov sp, r7
-    emit(0xbd80); // pop {r7, pc}
+    if (frame_parms) {
+        emit(0xb000 | frame_parms); // add sp, #parms*4
+    }
+    emit(0xbd80 | regs); // pop {r4-r6,r7,pc}
+}
+
+// frame pointer offset of local variable or parameter n
+static int frame_offset(int n) {
+    if (n >= frame_parms) { // parameter on the caller's stack, skip the saved registers
+        n += saved_count();
+    }
+    return n * 4;
 }
 
-static void emit_load_addr(int n) {
-    emit_load_immediate(0, (n) * 4);
-    emit(0x4438); // add r0,r7
+static void emit_mov(int rd, int rm) {
+    if (rd != rm) {
+        emit(0x4600 | ((rd & 8) << 4) | (rm << 3) | (rd & 7)); // mov rd, rm
+    }
+}
+
+static void emit_load_addr(int r, int n) {
+    n = frame_offset(n);
+    if (n >= 0 && n < 256) {
+        emit(0x2000 | (r << 8) | n); // movs rr, #n
+        emit(0x4438 | r);            // add  rr, r7
+    } else if (n < 0 && n > -8) {
+        emit(0x1e38 | (-n << 6) | r); // subs rr, r7, #n
+    } else if (n < 0 && n > -256) {
+        emit(0x4638 | r);             // mov  rr, r7
+        emit(0x3800 | (r << 8) | -n); // subs rr, #n
+    } else {
+        emit_load_immediate(r, n);
+        emit(0x4438 | r); // add rr, r7
+    }
 }
 
 static void emit_push(int n) {
@@ -169,36 +803,89 @@ static void emit_pop(int n) {
     emit(0xbc00 | (1 << n)); // pop {rn}
 }
 
-static void emit_store(int n) {
-    emit_pop(3);
+// store rs to the address held in ra plus v if the offset can be encoded
+static int emit_store_offset(int n, int rs, int ra, int v) {
     switch (n) {
     case SC:
-        emit(0x7018); // strb r0,[r3,#0]
+        if (v < 0 || v > 31) {
+            return 0;
+        }
+        emit(0x7000 | (v << 6) | (ra << 3) | rs); // strb rs,[ra,#v]
         break;
     case SI:
     case SF:
-        emit(0x6018); // str r0,[r3,#0]
+        if (v < 0 || v > 124) {
+            return 0;
+        }
+        emit(0x6000 | (v << 4) | (ra << 3) | rs); // str rs,[ra,#v]
         break;
     default:
         fatal("unexpected compiler error");
     }
+    return 1;
 }
 
-static void emit_load(int n) {
+// store rs at the address held in ra
+static void emit_store(int n, int rs, int ra) {
+    emit_store_offset(n, rs, ra, 0);
+}
+
+// store r0 to local variable or parameter v if it can be addressed directly
+static int emit_store_frame(int n, int v) {
+    return emit_store_offset(n, 0, 7, frame_offset(v));
+}
+
+// offset of global a from the data base register for an access of "size"
+// bytes, -1 if it can't be addressed from there
+static int glo_offset(int a, int size) {
+    return (consts_live && glo_reg) ? glo_reach(glo_base, a, size) : -1;
+}
+
+// store r0 to the global at address a if it can be addressed directly
+static int emit_store_global(int n, int a) {
+    int v = glo_offset(a, (n == SC) ? 1 : 4);
+    return v >= 0 && emit_store_offset(n, 0, glo_reg, v);
+}
+
+// load rd from the address held in ra plus v if the offset can be encoded
+static int emit_load_offset(int n, int rd, int ra, int v) {
     switch (n) {
     case LC:
-        emit(0x7800); // ldrb r0,[r0,#0]
+        if (v < 0 || v > 31) {
+            return 0;
+        }
+        emit(0x7800 | (v << 6) | (ra << 3) | rd); // ldrb rd,[ra,#v]
         if (!uchar_opt) {
-            emit(0xb240); // sxtb r0,r0
+            emit(0xb240 | (rd << 3) | rd); // sxtb rd,rd
         }
         break;
     case LI:
     case LF:
-        emit(0x6800); // ldr r0, [r0, #0]
+        if (v < 0 || v > 124) {
+            return 0;
+        }
+        emit(0x6800 | (v << 4) | (ra << 3) | rd); // ldr rd,[ra,#v]
         break;
     default:
         fatal("unexpected compiler error");
     }
+    return 1;
+}
+
+// load rd from the address held in ra
+static void emit_load(int n, int rd, int ra) {
+    emit_load_offset(n, rd, ra, 0);
+}
+
+// load rd from local variable or parameter v if it can be addressed directly
+static int emit_load_frame(int n, int rd, int v) {
+    return emit_load_offset(n, rd, 7, frame_offset(v));
+}
+
+// load rd from the global at address a if it can be addressed directly
+static int emit_load_global(int n, int rd, int a) {
+    int v = glo_offset(a, (n == LC) ? 1 : 4);
+    return v >= 0 && emit_load_offset(n, rd, glo_reg, v);
 }
 
 static uint16_t* emit_call(int n);
@@ -212,199 +899,263 @@ static void emit_branch(uint16_t* to) {
     }
 }
 
+static void emit_extern_call(int a, int v);
+
 static void emit_fop(int n) {
-    if (!ofn) {
-        emit_load_long_imm(3, (int)fops[n], 0);
-    } else {
-        emit_load_long_imm(3, -n, 1);
-    }
-    emit(0x4798); // blx r3
+    emit_extern_call((int)fops[n], -n);
 }
 
-static void emit_cond_branch(uint16_t* to, int cond) {
+// conditional branch, cc is the Thumb condition code
+static void emit_branch_cc(uint16_t* to, int cc) {
     int ofs = to - (e + 1);
     if (ofs >= -128 && ofs < 128) {
-        switch (cond) {
-        case BZ:
-            emit(0xd000 | (ofs & 0xff)); // be to
-            break;
-        case BNZ:
-            emit(0xd100 | (ofs & 0xff)); // bne to
-            break;
-        default:
-            fatal("unexpected compiler error");
-        }
+        emit(0xd000 | (cc << 8) | (ofs & 0xff)); // b<cc> to
         return;
     }
     if (ofs >= -1023 && ofs < 1024) {
-        switch (cond) {
-        case BZ:
-            emit(0xd100); // bne *+2
-            break;
-        case BNZ:
-            emit(0xd000); // be *+2
-            break;
-        default:
-            fatal("unexpected compiler error");
-        }
+        emit(0xd000 | ((cc ^ 1) << 8)); // b<!cc> *+2
         --ofs;
         emit(0xe000 | (ofs & 0x7ff)); // JMP to
         return;
     }
+    emit(0xd001 | ((cc ^ 1) << 8)); // b<!cc> *+3
+    emit_call((int)(to + 2));       // JMP to
+}
+
+static void emit_cond_branch(uint16_t* to, int cond) {
     switch (cond) {
     case BZ:
-        emit(0xd101); // bne *+3
+        emit_branch_cc(to, 0x0); // be to
         break;
     case BNZ:
-        emit(0xd001); // be *+3
+        emit_branch_cc(to, 0x1); // bne to
         break;
     default:
         fatal("unexpected compiler error");
     }
-    emit_call((int)to); // JMP to
 }
 
-static void emit_oper(int op) {
-    switch (op) {
-    case OR:
-        emit_pop(3);
-        emit(0x4318); // orrs r0,r3
-        break;
-    case XOR:
-        emit_pop(3);
-        emit(0x4058); // eors r0,r3
-        break;
-    case AND:
-        emit_pop(3);
-        emit(0x4018); // ands r0,r3
-        break;
-    case SHL:
-        emit(0x4603); // mov r3,r0
-        emit_pop(0);
-        emit(0x4098); // lsls r0,r3
-        break;
-    case SHR:
-        emit(0x4603); // mov r3, r0
-        emit_pop(0);
-        emit(0x4118); // asrs r0,r3
-        break;
-    case SUB:
-        emit_pop(3);
-        emit(0x1a18); // subs r0,r3,r0;
+// a scratch register from r1-r3 other than the ones in use
+static int scratch_reg(int used) {
+    for (int r = 3; r > 0; --r) {
+        if (!((used | temps_live) & (1 << r))) {
+            return r;
+        }
+    }
+    fatal("unexpected compiler error");
+    return 0;
+}
+
+// commutative operation: r0 = rl op rr
+static void emit_alu(int op, int rl, int rr) {
+    if (rl && rr) {
+        emit_mov(0, rl);
+        rl = 0;
+    }
+    emit(op | ((rl ? rl : rr) << 3)); // op r0, rm
+}
+
+// shift: r0 = rl op rr, the operand registers are consumed
+static void emit_shift(int op, int rl, int rr) {
+    if (rl == 0) {
+        emit(op | (rr << 3)); // op r0, rr
+    } else if (rr == 0) {
+        emit(op | rl); // op rl, r0
+        emit_mov(0, rl);
+    } else {
+        emit_mov(0, rl);
+        emit(op | (rr << 3)); // op r0, rr
+    }
+}
+
+// r0 = rl >= rr (signed)
+static void emit_ge(int rl, int rr) {
+    int used = (1 << rl) | (1 << rr);
+    if (rl == 0 || rr == 0) {
+        int s = scratch_reg(used);
+        emit_mov(s, 0);
+        if (rl == 0) {
+            rl = s;
+        } else {
+            rr = s;
+        }
+        used |= 1 << s;
+    }
+    int s = scratch_reg(used);
+    emit(0x17c0 | (rl << 3));      // asrs r0,rl,#31
+    emit(0x0fc0 | (rr << 3) | s);  // lsrs s,rr,#31
+    emit(0x4280 | (rr << 3) | rl); // cmp  rl,rr
+    emit(0x4140 | (s << 3));       // adcs r0,s
+}
+
+// r0 = rl < rr or rl > rr
+static void emit_lt(int cond, int rl, int rr) {
+    int s = scratch_reg((1 << rl) | (1 << rr));
+    emit(0x2001 | (s << 8));       // movs s,#1
+    emit(0x4280 | (rr << 3) | rl); // cmp  rl,rr
+    emit(cond);                    // blt.n / bgt.n L1
+    emit(0x2000 | (s << 8));       // movs s,#0
+    peep_barrier();                // L1:
+    emit_mov(0, s);
+}
+
+// move the operands to r0 and r1 for a run time library call
+static void emit_call_args(int rl, int rr) {
+    if (rr == 0) {
+        if (rl == 1) {
+            emit(0x4602); // mov r2,r0
+            emit(0x4608); // mov r0,r1
+            emit(0x4611); // mov r1,r2
+        } else {
+            emit(0x4601); // mov r1,r0
+            emit_mov(0, rl);
+        }
+    } else if (rl == 1) {
+        emit(0x4608); // mov r0,r1
+        emit_mov(1, rr);
+    } else {
+        emit_mov(1, rr);
+        emit_mov(0, rl);
+    }
+}
+
+// signed r0 / r1 or r0 % r1 on the SIO divider, its results are ready 8 cycles
+// after the divisor is written. When the divider is dirty the code runs in an
+// interrupt handler which interrupted a division, the helper call saving and
+// restoring the divider's state is taken instead
+static void emit_divider(int op) {
+    uint16_t *busy, *done;
+    emit(0x22d0); // movs r2,#0xd0
+    emit(0x0612); // lsls r2,r2,#24 ; SIO_BASE
+    emit(0x6f93); // ldr  r3,[r2,#0x78] ; DIV_CSR
+    emit(0x089b); // lsrs r3,r3,#2 ; DIRTY into carry
+    busy = e + 1;
+    emit(0xd200); // bcs  busy
+    emit(0x6690); // str  r0,[r2,#0x68] ; DIV_SDIVIDEND
+    emit(0x66d1); // str  r1,[r2,#0x6c] ; DIV_SDIVISOR
+    for (int i = 0; i < 4; ++i) {
+        emit(0xe7ff); // b .+2
+    }
+    if (op == DIV) {
+        emit(0x6f10); // ldr r0,[r2,#0x70] ; DIV_QUOTIENT
+    } else {
+        emit(0x6f50); // ldr r0,[r2,#0x74] ; DIV_REMAINDER
+        emit(0x6f13); // ldr r3,[r2,#0x70] ; DIV_QUOTIENT, clears DIRTY
+    }
+    done = e + 1;
+    emit(0xe000); // b done
+    *busy |= e - busy - 1;
+    peep_barrier(); // busy:
+    emit_fop(aeabi_idiv);
+    if (op == MOD) {
+        emit(0x4608); // mov r0,r1
+    }
+    *done |= e - done - 1;
+    peep_barrier(); // done:
+}
+
+// binary operation: r0 = rl op rr, the operand registers are consumed
+static void emit_oper(int op, int rl, int rr) {
+    switch (op) {
+    case OR:
+        emit_alu(0x4300, rl, rr); // orrs
         break;
-    case ADD:
-        emit_pop(3);
-        emit(0x18c0); // adds r0,r3;
+    case XOR:
+        emit_alu(0x4040, rl, rr); // eors
+        break;
+    case AND:
+        emit_alu(0x4000, rl, rr); // ands
         break;
     case MUL:
-        emit_pop(3);
-        emit(0x4358); // muls r0,r3;
+        emit_alu(0x4340, rl, rr); // muls
+        break;
+    case SHL:
+        emit_shift(0x4080, rl, rr); // lsls
+        break;
+    case SHR:
+        emit_shift(0x4100, rl, rr); // asrs
+        break;
+    case SUB:
+        emit(0x1a00 | (rr << 6) | (rl << 3)); // subs r0,rl,rr
+        break;
+    case ADD:
+        emit(0x1800 | (rr << 6) | (rl << 3)); // adds r0,rl,rr
         break;
 
     case EQ:
-        emit_pop(1);
-        emit(0x1a08); // subs r0,r1,r0
-        emit(0x4243); // negs r3,r0 //FIX
-        emit(0x4158); // adcs r0,r3
+        emit(0x1a00 | (rr << 6) | (rl << 3)); // subs r0,rl,rr
+        rl = rl ? rl : rr;
+        emit(0x4240 | rl);        // negs rl,r0
+        emit(0x4140 | (rl << 3)); // adcs r0,rl
         break;
     case NE:
-        emit_pop(1);
-        emit(0x1a08); // subs r0,r1,r0
-        emit(0x1e43); // subs r3,r0,#1 //FIX
-        emit(0x4198); // sbcs r0,r3
+        emit(0x1a00 | (rr << 6) | (rl << 3)); // subs r0,rl,rr
+        rl = rl ? rl : rr;
+        emit(0x1e40 | rl);        // subs rl,r0,#1
+        emit(0x4180 | (rl << 3)); // sbcs r0,rl
         break;
     case GE:
-        emit_pop(1);
-        emit(0x0003); // movs r3,r0
-        emit(0x17c8); // asrs r0,r1,#31
-        emit(0x0fda); // lsrs r2,r3,#31
-        emit(0x4299); // cmp  r1,r3
-        emit(0x4150); // adcs r0,r2
+        emit_ge(rl, rr);
+        break;
+    case LE:
+        emit_ge(rr, rl);
         break;
     case LT:
-        emit_pop(1);
-        emit(0x2301); // movs r3,#1
-        emit(0x4281); // cmp  r1,r0
-        emit(0xdb00); // blt.n L2
-        emit(0x2300); // movs r3,#0
-                      // L2:
-        emit(0x0018); // movs r0,r3
+        emit_lt(0xdb00, rl, rr); // blt.n
         break;
     case GT:
-        emit_pop(1);
-        emit(0x2301); // movs r3,#1
-        emit(0x4281); // cmp  r1,r0
-        emit(0xdc00); // bgt.n L1
-        emit(0x2300); // movs r3,#0
-                      // L1:
-        emit(0x0018); // movs r0,r3
-        break;
-    case LE:
-        emit_pop(1);
-        emit(0x0003); // movs r3,r0
-        emit(0x0fc8); // lsrs r0,r1,#31
-        emit(0x17da); // asrs r2,r3,#31
-        emit(0x428b); // cmp  r3,r1
-        emit(0x4150); // adcs r0,r2
+        emit_lt(0xdc00, rl, rr); // bgt.n
         break;
 
     case DIV:
     case MOD:
-        emit(0x4601); // mov r1,r0
-        emit_pop(0);  // pop {r0}
-        emit_fop(aeabi_idiv);
-        if (op == MOD) {
-            emit(0x4608); // mov r0,r1
-        }
+        emit_call_args(rl, rr);
+        emit_divider(op);
         break;
     default:
         fatal("unexpected compiler error");
     }
 }
 
-static void emit_float_oper(int op) {
+static void emit_float_oper(int op, int rl, int rr) {
     switch (op) {
     case ADDF:
-        emit_pop(1); // pop {r1}
+        emit_call_args(rr, rl);
         emit_fop((int)aeabi_fadd);
         break;
     case SUBF:
-        emit(0x0001); // movs r1,r0
-        emit_pop(0);
+        emit_call_args(rl, rr);
         emit_fop((int)aeabi_fsub);
         break;
     case MULF:
-        emit_pop(1);
+        emit_call_args(rr, rl);
         emit_fop((int)aeabi_fmul);
         break;
     case DIVF:
-        emit(0x0001); // movs r1,r0
-        emit_pop(0);
+        emit_call_args(rl, rr);
         emit_fop((int)aeabi_fdiv);
         break;
     case GEF:
-        emit(0x0001); // movs r1,r0
-        emit_pop(0);
+        emit_call_args(rl, rr);
         emit_fop((int)aeabi_fcmpge);
         break;
     case GTF:
-        emit_pop(1);
-        emit_fop((int)aeabi_fcmple);
+        emit_call_args(rl, rr);
+        emit_fop((int)aeabi_fcmpgt);
         break;
     case LTF:
-        emit_pop(1);
-        emit_fop((int)aeabi_fcmpge);
+        emit_call_args(rl, rr);
+        emit_fop((int)aeabi_fcmplt);
         break;
     case LEF:
-        emit(0x0001); // movs r1,r0
-        emit_pop(0);
+        emit_call_args(rl, rr);
         emit_fop((int)aeabi_fcmple);
         break;
     case EQF:
-        emit_oper(EQ);
+        emit_oper(EQ, rl, rr);
         break;
     case NEF:
-        emit_oper(NE);
+        emit_oper(NE, rl, rr);
         break;
 
     default:
@@ -425,166 +1176,1879 @@ static void emit_cast(int n) {
     }
 }
 
-static void emit_adjust_stack(int n) {
-    if (n) {
-        emit(0xb000 | n); // add sp, #n*4
+static void emit_adjust_stack(int n) {
+    if (n) {
+        emit(0xb000 | n); // add sp, #n*4
+    }
+}
+
+// encode a bl placed at address "at" calling address "to", 0 if out of reach
+int encode_call(uint16_t* at, int to, uint16_t* bl) {
+    int ofs = (to - ((int)at + 4)) / 2;
+    if (ofs < -8388608 || ofs > 8388607) {
+        return 0;
+    }
+    int s = (ofs >> 31) & 1;
+    int i1 = ((ofs >> 22) & 1) ^ 1;
+    int i2 = ((ofs >> 21) & 1) ^ 1;
+    int j1 = s ^ i1;
+    int j2 = s ^ i2;
+    int i11 = ofs & ((1 << 11) - 1);
+    int i10 = (ofs >> 11) & ((1 << 10) - 1);
+    bl[0] = 0xf000 | (s << 10) | i10;
+    bl[1] = 0xd000 | (j1 << 13) | (j2 << 11) | i11;
+    return 1;
+}
+
+static uint16_t* emit_call(int n) {
+    uint16_t bl[2];
+    if (!(frame_kind & FRAME_LR)) {
+        fatal("unexpected compiler error");
+    }
+    if (n == 0) {
+        emit(0);
+        emit(0);
+        return e - 1;
+    }
+    if (!encode_call(e + 1, n, bl)) {
+        fatal("subroutine call too far");
+    }
+    emit(bl[0]);
+    emit(bl[1]);
+    return e - 1;
+}
+
+// Call an external function or floating point helper at address a, v is its
+// relocation value. A bl is used when it reaches the function. In an
+// executable the bl holds v until the loader sets its offset, the relocation
+// address has bit 0 set to tell it from a literal word.
+static void emit_extern_call(int a, int v) {
+    uint16_t bl[2];
+    if (!(frame_kind & FRAME_LR)) {
+        fatal("unexpected compiler error");
+    }
+    if (!encode_call(e + 1, a & ~1, bl)) {
+        emit_load_long_imm(3, ofn ? v : a, 1);
+        emit(0x4798); // blx r3
+        return;
+    }
+    if (!ofn) {
+        emit(bl[0]);
+        emit(bl[1]);
+        return;
+    }
+    uint16_t* b = emit_call(0);
+    b[0] = v;
+    b[1] = v >> 16;
+    peep_barrier(); // not an instruction until loaded
+    struct reloc_s* r = cc_malloc(sizeof(struct reloc_s), 1);
+    r->addr = (int)b | 1;
+    r->next = relocs;
+    relocs = r;
+    nrelocs++;
+}
+
+static void emit_syscall(int n, int np) {
+    const struct externs_s* p = externs + n;
+    if (p->is_printf) {
+        emit_load_immediate(0, np);
+        emit_extern_call((int)x_printf, n);
+    } else if (p->is_sprintf) {
+        emit_load_immediate(0, np);
+        emit_extern_call((int)x_sprintf, n);
+    } else {
+        int nparm = np & ADJ_MASK;
+        if (nparm > 4) {
+            nparm = 4;
+        }
+        while (nparm--) {
+            emit_pop(nparm);
+        }
+        emit_extern_call((int)p->extrn, n);
+    }
+    int nparm = np & ADJ_MASK;
+    if (p->is_printf || p->is_sprintf) {
+        emit_adjust_stack(nparm);
+    } else {
+        nparm = (nparm > 4) ? nparm - 4 : 0;
+        if (nparm) {
+            emit_adjust_stack(nparm);
+        }
+    }
+}
+
+static void patch_branch(uint16_t* from, uint16_t* to) {
+    if (*from != 0 || *(from + 1) != 0) {
+        fatal("unexpected compiler error");
+    }
+    if (to == e + 1) { // the pool may go ahead of the code to come
+        place_pool();
+        to = e + 1;
+    }
+    uint16_t* se = e;
+    e = from - 1;
+    emit_call((int)to);
+    e = se;
+    if (to > e) {
+        peep_barrier(); // the code to come is a branch target
+    }
+}
+
+// switch statements
+//
+// The case labels are collected while the switch body is generated and the
+// dispatch code placed after it, entered with the switch value in r0. Dense
+// case values index a table of branch offsets, sparse ones are searched with
+// a balanced tree of compares.
+
+#define CASE_TABLE_MAX 256 // largest jump table (entries)
+
+// compare r0 with a constant
+static void emit_cmp_imm(int v) {
+    if (v >= 0 && v < 256) {
+        emit(0x2800 | v); // cmp r0,#v
+    } else {
+        emit_load_immediate(3, v);
+        emit(0x4298); // cmp r0,r3
+    }
+}
+
+// branch to the default label, or past the switch if there is none
+static void emit_case_default(uint16_t* dflt) {
+    if (dflt) {
+        emit_branch(dflt - 2);
+    } else {
+        struct patch_s* patch = cc_malloc(sizeof(struct patch_s), 1);
+        patch->addr = emit_call(0);
+        patch->next = brks;
+        brks = patch;
+    }
+}
+
+// balanced compare tree over the sorted case labels c[lo] to c[hi]
+static void gen_case_tree(struct patch_s** c, int lo, int hi, uint16_t* dflt) {
+    check_pc_relative();
+    if (hi - lo < 3) {
+        for (; lo <= hi; ++lo) {
+            emit_cmp_imm(c[lo]->val);
+            emit_branch_cc(c[lo]->addr - 2, 0x0); // be case
+        }
+        emit_case_default(dflt);
+        return;
+    }
+    int mid = (lo + hi) / 2;
+    emit_cmp_imm(c[mid]->val);
+    emit_branch_cc(c[mid]->addr - 2, 0x0); // be case
+    emit(0xdd01);                          // ble *+3
+    uint16_t* a = emit_call(0);            // JMP upper half
+    gen_case_tree(c, lo, mid - 1, dflt);
+    patch_branch(a, e + 1);
+    gen_case_tree(c, mid + 1, hi, dflt);
+}
+
+// table of branch offsets indexed by the case value
+static void gen_case_table(struct patch_s** c, int k, uint16_t* dflt) {
+    int lo = c[0]->val;
+    int n = c[k - 1]->val - lo;
+    // keep pending pc relative loads in reach across the table
+    if (pcrel_1st && pool_span() + 2 * n + 64 > POOL_REACH) {
+        patch_pc_relative(1);
+    }
+    if (lo > 0 && lo < 256) {
+        emit(0x3800 | lo); // subs r0,#lo
+    } else if (lo < 0 && lo > -256) {
+        emit(0x3000 | -lo); // adds r0,#-lo
+    } else if (lo) {
+        emit_load_immediate(3, lo);
+        emit(0x1ac0); // subs r0,r0,r3
+    }
+    emit_cmp_imm(n);
+    uint16_t* b = e + 1;
+    emit(0xd900); // bls.n over the default branch
+    emit_case_default(dflt);
+    *b |= e - b - 1;
+    if (!dflt) {
+        dflt = b + 1; // the branch past the switch
+    }
+    emit(0x0040); // lsls r0,r0,#1
+    emit(0x4478); // add  r0,pc
+    emit(0x88c0); // ldrh r0,[r0,#6]
+    emit(0x467b); // mov  r3,pc
+    emit(0x1a1b); // subs r3,r3,r0
+    emit(0x469f); // mov  pc,r3
+    uint16_t* base = e; // pc read by mov r3,pc
+    for (int i = 0, j = 0; i <= n; ++i) {
+        uint16_t* to = dflt;
+        if (c[j]->val - lo == i) {
+            to = c[j++]->addr;
+        }
+        emit_half((base - to) * 2); // offset back to the case label
+    }
+    peep_barrier(); // the table is data, not instructions to rewrite
+}
+
+// dispatch the switch value in r0 to the collected case labels
+static void gen_switch(uint16_t* dflt) {
+    struct patch_s *p, **c;
+    int i, j, k = 0;
+    for (p = cases; p; p = p->next) {
+        ++k;
+    }
+    if (k == 0) {
+        emit_case_default(dflt);
+        return;
+    }
+    c = cc_malloc(k * sizeof(struct patch_s*), 0);
+    for (p = cases, i = 0; p; p = p->next, ++i) { // insertion sort by case value
+        for (j = i; j > 0 && c[j - 1]->val > p->val; --j) {
+            c[j] = c[j - 1];
+        }
+        if (j > 0 && c[j - 1]->val == p->val) {
+            fatal("duplicate case value");
+        }
+        c[j] = p;
+    }
+    unsigned span = (unsigned)c[k - 1]->val - (unsigned)c[0]->val;
+    if (k >= 4 && span < 3 * k && span < CASE_TABLE_MAX) {
+        gen_case_table(c, k, dflt);
+    } else {
+        gen_case_tree(c, 0, k - 1, dflt);
+    }
+    cc_free(c);
+    while (cases) {
+        p = cases->next;
+        cc_free(cases);
+        cases = p;
+    }
+}
+
+// expression analysis for temporary register allocation
+
+// evaluation order of the operands of a binary operation
+enum { LEAF_RIGHT, LEAF_LEFT, LEFT_FIRST, RIGHT_FIRST };
+
+static int max(int a, int b) {
+    return (a > b) ? a : b;
+}
+
+// divisor of Div or Mod n when it is a constant power of two, 1 or their
+// negation, done inline without the division helper. 0 otherwise
+static int div_pow2(int* n) {
+    int* r = n + Oper_words;
+    int v;
+    if ((ast_Tk(n) != Div && ast_Tk(n) != Mod) || ast_Tk(r) != Num) {
+        return 0;
+    }
+    v = Num_entry(r).val;
+    if (v < 0 && v != (int)0x80000000) {
+        v = -v;
+    }
+    return (v > 0 && v <= 0x40000000 && is_power_of_2(v)) ? Num_entry(r).val : 0;
+}
+
+// expression that can be loaded into any register without using others
+static int is_leaf(int* n) {
+    switch (ast_Tk(n)) {
+    case Num:
+    case NumF:
+    case Loc:
+        return 1;
+    case Load:
+        return is_leaf(n + Load_words);
+    }
+    return 0;
+}
+
+// float to int or int to float conversion done by an assignment
+static int assign_cast(int* n) {
+    int t = Assign_entry(n).type;
+    if ((t >> 16) == FLOAT && (t & 0xffff) == INT) {
+        return FTOI;
+    }
+    if ((t >> 16) == INT && (t & 0xffff) == FLOAT) {
+        return ITOF;
+    }
+    return 0;
+}
+
+// compound assignment, the value is computed from the variable addressed by r0
+static int is_compound(int* n) {
+    int i = ast_Tk(n);
+    if (is_binary(i)) {
+        return is_compound((int*)Oper_entry(n).oprnd);
+    }
+    switch (i) {
+    case ';':
+        return 1;
+    case Load:
+        return is_compound(n + Load_words);
+    case CastF:
+        return is_compound((int*)CastF_entry(n).val);
+    }
+    return 0;
+}
+
+// assignment to a variable that can be addressed after evaluating the value
+static int assign_direct(int* n) {
+    return is_leaf((int*)Assign_entry(n).right_part) && !is_compound(n + Assign_words);
+}
+
+static int clobbers(int* n);
+
+// registers that may be overwritten while evaluating and converting an assigned value
+static int assign_clobbers(int* n) {
+    return assign_cast(n) ? SCRATCH_REGS : clobbers(n + Assign_words);
+}
+
+// registers among r1-r3 that may be overwritten while evaluating n
+static int clobbers(int* n) {
+    int i = ast_Tk(n);
+    if (is_binary(i)) {
+        if ((i >= Ge && i <= Le) || (i >= Div && !div_pow2(n))) {
+            return SCRATCH_REGS;
+        }
+        return clobbers((int*)Oper_entry(n).oprnd) | clobbers(n + Oper_words) | (1 << 3);
+    }
+    switch (i) {
+    case Num:
+    case NumF:
+    case Loc:
+    case ';':
+        return 0;
+    case Load:
+        return clobbers(n + Load_words);
+    case Inc:
+    case Dec:
+        return clobbers(n + Oper_words) | (1 << 2) | (1 << 3);
+    case '{':
+    case Link:
+        return clobbers((int*)Begin_entry(n).next) | clobbers(n + Begin_words);
+    case Lor:
+    case Lan:
+        return clobbers((int*)Oper_entry(n).oprnd) | clobbers(n + Oper_words);
+    case Cond:
+        return clobbers((int*)Cond_entry(n).cond_part) | clobbers((int*)Cond_entry(n).if_part) |
+               (Cond_entry(n).else_part ? clobbers((int*)Cond_entry(n).else_part) : 0);
+    case Assign:
+        return clobbers((int*)Assign_entry(n).right_part) | assign_clobbers(n) | (1 << 3);
+    }
+    return SCRATCH_REGS;
+}
+
+static int eval_order(int* l, int* r, int nl, int nr) {
+    if (is_leaf(r)) {
+        return LEAF_RIGHT;
+    }
+    if (is_leaf(l)) {
+        return LEAF_LEFT;
+    }
+    if (nr > nl && !has_side_effects(l) && !has_side_effects(r)) {
+        return RIGHT_FIRST;
+    }
+    return LEFT_FIRST;
+}
+
+// Sethi-Ullman number, the temporaries needed to evaluate n
+static int su_number(int* n) {
+    int i = ast_Tk(n), nl, nr;
+    int *l, *r;
+    if (is_binary(i)) {
+        l = (int*)Oper_entry(n).oprnd;
+        r = n + Oper_words;
+        nl = su_number(l);
+        nr = su_number(r);
+        switch (eval_order(l, r, nl, nr)) {
+        case LEAF_RIGHT:
+            return nl;
+        case LEAF_LEFT:
+            return nr;
+        case LEFT_FIRST:
+            return max(nl, nr + 1);
+        default:
+            return max(nr, nl + 1);
+        }
+    }
+    switch (i) {
+    case Load:
+        return su_number(n + Load_words);
+    case Inc:
+    case Dec:
+        return su_number(n + Oper_words);
+    case CastF:
+        return su_number((int*)CastF_entry(n).val);
+    case '{':
+    case Link:
+        return max(su_number((int*)Begin_entry(n).next), su_number(n + Begin_words));
+    case Lor:
+    case Lan:
+        return max(su_number((int*)Oper_entry(n).oprnd), su_number(n + Oper_words));
+    case Cond:
+        return max(max(su_number((int*)Cond_entry(n).cond_part),
+                       su_number((int*)Cond_entry(n).if_part)),
+                   Cond_entry(n).else_part ? su_number((int*)Cond_entry(n).else_part) : 0);
+    case Assign:
+        if (assign_direct(n)) {
+            return su_number(n + Assign_words);
+        }
+        return max(su_number((int*)Assign_entry(n).right_part), su_number(n + Assign_words) + 1);
+    case Func:
+    case Syscall:
+        nl = 0;
+        if (Func_entry(n).next) {
+            for (l = (int*)Func_entry(n).next; l; l = (int*)ast_Tk(l)) {
+                nl = max(nl, su_number(l + 1));
+            }
+        }
+        return nl;
+    }
+    return 0;
+}
+
+// user function arguments
+//
+// The first four arguments are passed in r0-r3, the others pushed before them
+// with the last one on top. Register arguments needing evaluation go last to
+// first through r0, one stays in its register when evaluating those before it
+// leaves that register alone, otherwise it is pushed and popped once they are
+// all done. Variables and constants are loaded into their registers at the end.
+
+// the argument expressions of call n in source order, returns their number
+static int call_args(int* n, int** a) {
+    int k = 0;
+    for (int* l = (int*)Func_entry(n).next; l; l = (int*)ast_Tk(l)) {
+        a[k++] = l + 1; // listed last to first
+    }
+    for (int i = 0; i < k / 2; ++i) {
+        int* t = a[i];
+        a[i] = a[k - 1 - i];
+        a[k - 1 - i] = t;
+    }
+    return k;
+}
+
+// registers among r1-r3 holding their argument while the earlier ones are evaluated
+static int arg_regs(int** a, int k) {
+    int held = 0, clob = 0;
+    for (int i = 0; i < k && i < 4; ++i) {
+        if (i && !is_leaf(a[i]) && !(clob & (1 << i))) {
+            held |= 1 << i;
+        }
+        clob |= clobbers(a[i]);
+    }
+    return held;
+}
+
+// scratch register available as a temporary while evaluating an operand
+static int low_temp(int clob, int live) {
+    for (int r = 1; r <= 2; ++r) {
+        if (!((clob | live) & (1 << r))) {
+            return r;
+        }
+    }
+    return 0;
+}
+
+static int saved_temps(int* n, int live);
+
+// callee saved temporaries needed to hold one operand while evaluating the other
+static int held_temps(int* first, int* second, int clob, int live) {
+    int t = low_temp(clob, live);
+    int k = saved_temps(first, live);
+    if (t) {
+        return max(k, saved_temps(second, live | (1 << t)));
+    }
+    return max(k, saved_temps(second, live) + 1);
+}
+
+// callee saved registers needed to evaluate the arguments of user function call n
+static int saved_arg_temps(int* n, int live) {
+    int* a[ADJ_MASK + 1];
+    int k = call_args(n, a), held = arg_regs(a, k), m = 0;
+    for (int i = 0; i < k; ++i) {
+        m = max(m, saved_temps(a[i], (i < 4) ? live | (held & (-2 << i)) : live));
+    }
+    return m;
+}
+
+// number of callee saved registers needed to evaluate n, mirrors the allocation done by gen
+static int saved_temps(int* n, int live) {
+    int i, k;
+    int *l, *r;
+    if (n == 0) {
+        return 0;
+    }
+    i = ast_Tk(n);
+    if (is_binary(i)) {
+        l = (int*)Oper_entry(n).oprnd;
+        r = n + Oper_words;
+        switch (eval_order(l, r, su_number(l), su_number(r))) {
+        case LEAF_RIGHT:
+            return saved_temps(l, live);
+        case LEAF_LEFT:
+            return saved_temps(r, live);
+        case LEFT_FIRST:
+            return held_temps(l, r, clobbers(r), live);
+        default:
+            return held_temps(r, l, clobbers(l), live);
+        }
+    }
+    switch (i) {
+    case Load:
+        return saved_temps(n + Load_words, live);
+    case Inc:
+    case Dec:
+        return saved_temps(n + Oper_words, live);
+    case CastF:
+        return saved_temps((int*)CastF_entry(n).val, live);
+    case '{':
+    case Link:
+        return max(saved_temps((int*)Begin_entry(n).next, live),
+                   saved_temps(n + Begin_words, live));
+    case Lor:
+    case Lan:
+        return max(saved_temps((int*)Oper_entry(n).oprnd, live), saved_temps(n + Oper_words, live));
+    case Cond:
+        return max(max(saved_temps((int*)Cond_entry(n).cond_part, live),
+                       saved_temps((int*)Cond_entry(n).if_part, live)),
+                   saved_temps((int*)Cond_entry(n).else_part, live));
+    case Assign:
+        if (assign_direct(n)) {
+            return saved_temps(n + Assign_words, live);
+        }
+        return held_temps((int*)Assign_entry(n).right_part, n + Assign_words, assign_clobbers(n),
+                          live);
+    case Func:
+        return saved_arg_temps(n, live);
+    case Syscall:
+        k = 0;
+        if (Func_entry(n).next) {
+            for (l = (int*)Func_entry(n).next; l; l = (int*)ast_Tk(l)) {
+                k = max(k, saved_temps(l + 1, live));
+            }
+        }
+        return k;
+    case While:
+    case DoWhile:
+        return max(saved_temps((int*)While_entry(n).body, live),
+                   saved_temps((int*)While_entry(n).cond, live));
+    case For:
+        return max(max(saved_temps((int*)For_entry(n).init, live),
+                       saved_temps((int*)For_entry(n).body, live)),
+                   max(saved_temps((int*)For_entry(n).incr, live),
+                       saved_temps((int*)For_entry(n).cond, live)));
+    case Switch:
+        return max(saved_temps((int*)Switch_entry(n).cond, live),
+                   saved_temps((int*)Switch_entry(n).cas, live));
+    case Case:
+        return max(saved_temps((int*)Case_entry(n).next, live),
+                   saved_temps((int*)Case_entry(n).expr, live));
+    case Default:
+    case Return:
+        return saved_temps((int*)Num_entry(n).val, live);
+    case Enter:
+        return saved_temps(n + Enter_words, live);
+    }
+    return 0;
+}
+
+// tail calls
+//
+// A call whose value is returned, or a call statement ending the function,
+// doesn't need a frame of its own. A call of the function itself stores the
+// arguments to its parameters and jumps back to the start of the body, unless
+// the function hands out addresses inside its frame. A call of another
+// function taking up to three arguments restores the caller's registers, pops
+// the return address into lr through r3 and jumps to the function, which
+// returns straight to the caller's caller.
+
+#define TAILS_MAX 16 // tail calls considered per function
+
+static int* tail_calls[TAILS_MAX] UDATA; // calls compiled as jumps
+static int ntails UDATA;                 // calls listed
+static int tail_self UDATA;              // address of the function, calls to it loop
+static int tail_loops UDATA;             // some calls jump back to the body
+static uint16_t* tail_loop UDATA;        // code ahead of the body
+static uint16_t* tail_end UDATA;         // end of the last jump emitted
+
+// the address of a local variable or parameter of n is used as a value
+static int frame_escapes(int* n) {
+    int i;
+    int* l;
+    if (n == 0) {
+        return 0;
+    }
+    i = ast_Tk(n);
+    if (is_binary(i) || i == Lor || i == Lan) {
+        return frame_escapes((int*)Oper_entry(n).oprnd) || frame_escapes(n + Oper_words);
+    }
+    switch (i) {
+    case Num:
+    case NumF:
+    case ';':
+    case Label:
+    case Break:
+    case Continue:
+    case Goto:
+        return 0;
+    case Load:
+    case Inc:
+    case Dec:
+        l = n + Load_words;
+        return ast_Tk(l) != Loc && frame_escapes(l);
+    case '{':
+    case Link:
+        return frame_escapes((int*)Begin_entry(n).next) || frame_escapes(n + Begin_words);
+    case Assign:
+        l = (int*)Assign_entry(n).right_part;
+        return (ast_Tk(l) != Loc && frame_escapes(l)) || frame_escapes(n + Assign_words);
+    case CastF:
+        return frame_escapes((int*)CastF_entry(n).val);
+    case Cond:
+        return frame_escapes((int*)Cond_entry(n).cond_part) ||
+               frame_escapes((int*)Cond_entry(n).if_part) ||
+               frame_escapes((int*)Cond_entry(n).else_part);
+    case Func:
+    case Syscall:
+        for (l = (int*)Func_entry(n).next; l; l = (int*)ast_Tk(l)) {
+            if (frame_escapes(l + 1)) {
+                return 1;
+            }
+        }
+        return 0;
+    case While:
+    case DoWhile:
+        return frame_escapes((int*)While_entry(n).body) || frame_escapes((int*)While_entry(n).cond);
+    case For:
+        return frame_escapes((int*)For_entry(n).init) || frame_escapes((int*)For_entry(n).body) ||
+               frame_escapes((int*)For_entry(n).incr) || frame_escapes((int*)For_entry(n).cond);
+    case Switch:
+        return frame_escapes((int*)Switch_entry(n).cond) ||
+               frame_escapes((int*)Switch_entry(n).cas);
+    case Case:
+        return frame_escapes((int*)Case_entry(n).expr);
+    case Default:
+    case Return:
+        return frame_escapes((int*)Num_entry(n).val);
+    }
+    return 1;
+}
+
+// list user function call n as a tail call if it can jump, "escapes" when the
+// frame can't be reused
+static void tail_call(int* n, int escapes) {
+    int k = Func_entry(n).n_parms;
+    if (ast_Tk(n) != Func || ntails == TAILS_MAX) {
+        return;
+    }
+    if (Func_entry(n).addr == tail_self) {
+        if (k > 4 || escapes) {
+            return;
+        }
+        tail_loops = 1;
+    } else if (k > 3) {
+        return;
+    }
+    tail_calls[ntails++] = n;
+}
+
+// list the tail calls of statement n, "last" when the function returns after it
+static void find_tails(int* n, int last, int escapes) {
+    if (n == 0) {
+        return;
+    }
+    switch (ast_Tk(n)) {
+    case Link:
+        find_tails((int*)Begin_entry(n).next, last, escapes);
+        break;
+    case '{':
+        find_tails((int*)Begin_entry(n).next, 0, escapes);
+        find_tails(n + Begin_words, last, escapes);
+        break;
+    case Cond:
+        find_tails((int*)Cond_entry(n).if_part, last, escapes);
+        find_tails((int*)Cond_entry(n).else_part, last, escapes);
+        break;
+    case While:
+    case DoWhile:
+        find_tails((int*)While_entry(n).body, 0, escapes);
+        break;
+    case For:
+        find_tails((int*)For_entry(n).body, 0, escapes);
+        break;
+    case Switch:
+        find_tails((int*)Switch_entry(n).cas, 0, escapes);
+        break;
+    case Case:
+        find_tails((int*)Case_entry(n).expr, 0, escapes);
+        break;
+    case Default:
+        find_tails((int*)Num_entry(n).val, 0, escapes);
+        break;
+    case Return:
+        if (Num_entry(n).val) {
+            tail_call((int*)Num_entry(n).val, escapes);
+        }
+        break;
+    case Func:
+        if (last) {
+            tail_call(n, escapes);
+        }
+        break;
+    }
+}
+
+// call n is compiled as a jump
+static int is_tail(int* n) {
+    for (int i = 0; i < ntails; ++i) {
+        if (tail_calls[i] == n) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// the code emitted so far ends with a return or tail call that no branch jumps past
+static int ends_with_leave(void) {
+    return !peep_fenced() && ((*e & 0xff00) == 0xbd00 || *e == 0x4770 || e == tail_end);
+}
+
+// FRAME_* parts of the frame a function body needs: FRAME_PTR when it addresses
+// the frame, FRAME_LR when a call, helper call or bl jump overwrites lr
+static int frame_uses(int* n) {
+    int i, k;
+    int* l;
+    if (n == 0) {
+        return 0;
+    }
+    i = ast_Tk(n);
+    if (is_binary(i)) {
+        k = frame_uses((int*)Oper_entry(n).oprnd) | frame_uses(n + Oper_words);
+        return (i >= Div && !div_pow2(n)) ? k | FRAME_LR : k;
+    }
+    switch (i) {
+    case Num:
+    case NumF:
+    case ';':
+    case Label:
+        return 0;
+    case Loc:
+        return var_reg(n) ? 0 : FRAME_PTR;
+    case Load:
+        return frame_uses(n + Load_words);
+    case Inc:
+    case Dec:
+        return frame_uses(n + Oper_words);
+    case '{':
+    case Link:
+        return frame_uses((int*)Begin_entry(n).next) | frame_uses(n + Begin_words);
+    case Assign:
+        k = frame_uses((int*)Assign_entry(n).right_part) | frame_uses(n + Assign_words);
+        return assign_cast(n) ? k | FRAME_LR : k;
+    case CastF:
+        return frame_uses((int*)CastF_entry(n).val) | FRAME_LR;
+    case Lor:
+    case Lan:
+        return frame_uses((int*)Oper_entry(n).oprnd) | frame_uses(n + Oper_words) | FRAME_LR;
+    case Cond:
+        return frame_uses((int*)Cond_entry(n).cond_part) |
+               frame_uses((int*)Cond_entry(n).if_part) |
+               frame_uses((int*)Cond_entry(n).else_part) | FRAME_LR;
+    case Func:
+    case Syscall:
+        k = (is_tail(n) && Func_entry(n).addr != tail_self) ? 0 : FRAME_LR;
+        if (Func_entry(n).next) {
+            for (l = (int*)Func_entry(n).next; l; l = (int*)ast_Tk(l)) {
+                k |= frame_uses(l + 1);
+            }
+        }
+        return k;
+    case While:
+    case DoWhile:
+        return frame_uses((int*)While_entry(n).body) | frame_uses((int*)While_entry(n).cond) |
+               FRAME_LR;
+    case For:
+        return frame_uses((int*)For_entry(n).init) | frame_uses((int*)For_entry(n).body) |
+               frame_uses((int*)For_entry(n).incr) | frame_uses((int*)For_entry(n).cond) |
+               FRAME_LR;
+    case Switch:
+        return frame_uses((int*)Switch_entry(n).cond) | frame_uses((int*)Switch_entry(n).cas) |
+               FRAME_LR;
+    case Case:
+        return frame_uses((int*)Case_entry(n).expr);
+    case Default:
+    case Return:
+        return frame_uses((int*)Num_entry(n).val);
+    case Enter:
+        return frame_uses(n + Enter_words);
+    case Break:
+    case Continue:
+    case Goto:
+        return FRAME_LR;
+    }
+    return FRAME_LR | FRAME_PTR;
+}
+
+// a use of variable n weighing w, or its address taken when w is 0
+static void var_use(int* n, int w) {
+    int i = var_index(Num_entry(n).val);
+    if (i < 0 || var_uses[i] < 0) {
+        return;
+    }
+    var_uses[i] = w ? var_uses[i] + w : -1;
+}
+
+// weigh the uses of the candidate variables in n, w per use
+static void count_vars(int* n, int w) {
+    int i, t;
+    int* l;
+    if (n == 0) {
+        return;
+    }
+    i = ast_Tk(n);
+    if (is_binary(i) || i == Lor || i == Lan) {
+        count_vars((int*)Oper_entry(n).oprnd, w);
+        if (!div_pow2(n)) {
+            count_vars(n + Oper_words, w);
+        }
+        return;
+    }
+    switch (i) {
+    case Num:
+    case NumF:
+        if (w >= 10) {
+            const_use(Num_entry(n).val, w);
+        }
+        break;
+    case Loc:
+        var_use(n, 0);
+        break;
+    case Load:
+        l = n + Load_words;
+        t = Load_entry(n).typ;
+        if (ast_Tk(l) == Loc) {
+            var_use(l, (t == INT || t == FLOAT || t >= PTR) ? w : 0);
+        } else {
+            if (ast_Tk(l) == Num) {
+                glo_use(Num_entry(l).val, (t == CHAR) ? 1 : 4, w);
+            }
+            count_vars(l, w);
+        }
+        break;
+    case Inc:
+    case Dec:
+        l = n + Oper_words;
+        if (ast_Tk(l) == Loc) {
+            var_use(l, (Num_entry(n).val != CHAR) ? w : 0);
+        } else {
+            if (ast_Tk(l) == Num) {
+                glo_use(Num_entry(l).val, (Num_entry(n).val == CHAR) ? 1 : 4, w);
+            }
+            count_vars(l, w);
+        }
+        break;
+    case '{':
+    case Link:
+        count_vars((int*)Begin_entry(n).next, w);
+        count_vars(n + Begin_words, w);
+        break;
+    case Assign:
+        l = (int*)Assign_entry(n).right_part;
+        t = Assign_entry(n).type & 0xffff;
+        if (ast_Tk(l) == Loc) {
+            var_use(l, (t == INT || t == FLOAT || t >= PTR) ? w : 0);
+        } else {
+            if (ast_Tk(l) == Num && assign_direct(n)) {
+                glo_use(Num_entry(l).val, (t == CHAR) ? 1 : 4, w);
+            }
+            count_vars(l, w);
+        }
+        count_vars(n + Assign_words, w);
+        break;
+    case CastF:
+        count_vars((int*)CastF_entry(n).val, w);
+        break;
+    case Cond:
+        count_vars((int*)Cond_entry(n).cond_part, w);
+        count_vars((int*)Cond_entry(n).if_part, w);
+        count_vars((int*)Cond_entry(n).else_part, w);
+        break;
+    case Func:
+    case Syscall:
+        for (l = (int*)Func_entry(n).next; l; l = (int*)ast_Tk(l)) {
+            count_vars(l + 1, w);
+        }
+        break;
+    case While:
+    case DoWhile:
+        w = (w < 10000) ? w * 10 : w;
+        count_vars((int*)While_entry(n).body, w);
+        count_vars((int*)While_entry(n).cond, w);
+        break;
+    case For:
+        count_vars((int*)For_entry(n).init, w);
+        w = (w < 10000) ? w * 10 : w;
+        count_vars((int*)For_entry(n).body, w);
+        count_vars((int*)For_entry(n).incr, w);
+        count_vars((int*)For_entry(n).cond, w);
+        break;
+    case Switch:
+        count_vars((int*)Switch_entry(n).cond, w);
+        count_vars((int*)Switch_entry(n).cas, w);
+        break;
+    case Case:
+        count_vars((int*)Case_entry(n).expr, w);
+        break;
+    case Default:
+    case Return:
+        count_vars((int*)Num_entry(n).val, w);
+        break;
+    }
+}
+
+// give the most used variables of function n registers from r4 up, leaving
+// one for the temporaries when they need any, constants and common values get
+// the rest
+static void alloc_vars(int* n) {
+    int k, best;
+    for (int i = 0; i < nvars; ++i) {
+        var_uses[i] = (var_slot[i] < Enter_entry(n).parms) ? 0 : -1; // not pushed by the caller
+        var_regs[i] = 0;
+    }
+    nconsts = nglos = 0;
+    count_vars(n + Enter_words, 1);
+    vars_saved = 0;
+    k = temps_saved ? 2 : 3;
+    while (vars_saved < k) {
+        best = -1;
+        for (int i = 0; i < nvars; ++i) {
+            if (!var_regs[i] && var_uses[i] > 1 && (best < 0 || var_uses[i] > var_uses[best])) {
+                best = i;
+            }
+        }
+        if (best < 0) {
+            break;
+        }
+        var_regs[best] = 4 + vars_saved++;
+    }
+    if (temps_saved > 3 - vars_saved) {
+        temps_saved = 3 - vars_saved;
+    }
+    alloc_consts(n);
+}
+
+// move r0 to a temporary register, or to the stack if none is available
+static int hold_temp(int clob) {
+    int t = low_temp(clob, temps_live);
+    for (int r = 4 + vars_saved; t == 0 && r < 4 + vars_saved + temps_saved; ++r) {
+        if (!(temps_live & (1 << r))) {
+            t = r;
+        }
+    }
+    if (t) {
+        emit_mov(t, 0);
+        temps_live |= 1 << t;
+    } else {
+        emit_push(0);
+    }
+    return t;
+}
+
+// release a temporary, returns the register holding its value
+static int release_temp(int t) {
+    if (t) {
+        temps_live &= ~(1 << t);
+        return t;
+    }
+    emit_pop(3);
+    return 3;
+}
+
+// load a leaf expression into register r
+static void gen_leaf(int* n, int r) {
+    int* a;
+    int t;
+    switch (ast_Tk(n)) {
+    case Num:
+    case NumF:
+        emit_load_immediate(r, Num_entry(n).val);
+        break;
+    case Loc:
+        emit_load_addr(r, Num_entry(n).val);
+        break;
+    case Load:
+        t = Load_entry(n).typ;
+        if (t > ATOM_TYPE && t < PTR) {
+            fatal("struct copies not yet supported");
+        }
+        t = (t >= PTR) ? LI : LC + (t >> 2);
+        a = n + Load_words;
+        if (var_reg(a)) {
+            emit_mov(r, var_reg(a));
+            break;
+        }
+        if (ast_Tk(a) == Loc && emit_load_frame(t, r, Num_entry(a).val)) {
+            break;
+        }
+        if (ast_Tk(a) == Num && emit_load_global(t, r, Num_entry(a).val)) {
+            break;
+        }
+        gen_leaf(a, r);
+        emit_load(t, r, r);
+        break;
+    default:
+        fatal("unexpected compiler error");
+    }
+}
+
+// operations with a small constant right operand
+static int gen_oper_imm(int op, int* r) {
+    if (ast_Tk(r) != Num) {
+        return 0;
+    }
+    int v = Num_entry(r).val;
+    switch (op) {
+    case SUB:
+        v = -v;
+        // fall through
+    case ADD:
+        if (v >= 0 && v < 256) {
+            emit(0x3000 | v); // adds r0,#v
+        } else if (v < 0 && v > -256) {
+            emit(0x3800 | -v); // subs r0,#v
+        } else {
+            return 0;
+        }
+        return 1;
+    case SHL:
+    case SHR:
+        if (v <= 0 || v > 31) {
+            return 0;
+        }
+        emit(((op == SHL) ? 0x0000 : 0x1000) | (v << 6)); // lsls / asrs r0,r0,#v
+        return 1;
+    }
+    return 0;
+}
+
+// register variable loaded by leaf n or register holding constant n, 0 if none
+static int leaf_reg(int* n) {
+    switch (ast_Tk(n)) {
+    case Load:
+        return var_reg(n + Load_words);
+    case Num:
+    case NumF:
+        return const_reg(Num_entry(n).val);
+    }
+    return 0;
+}
+
+// operation op leaves its operand registers untouched, a register variable
+// or constant can be one. Only rr when "right" is set
+static int keeps_operands(int op, int right) {
+    switch (op) {
+    case EQ:
+    case NE:
+    case EQF:
+    case NEF:
+        return 0;
+    case SHL:
+    case SHR:
+        return right;
+    }
+    return 1;
+}
+
+// evaluate the operands of binary operator n into the registers returned in
+// rl and rr, 0 if operation op was done with a small constant right operand
+static int gen_operands(int* n, int op, int* rl, int* rr) {
+    int* l = (int*)Oper_entry(n).oprnd;
+    int* r = n + Oper_words;
+    switch (eval_order(l, r, su_number(l), su_number(r))) {
+    case LEAF_RIGHT:
+        gen(l);
+        if (op < ADDF && gen_oper_imm(op, r)) {
+            return 0;
+        }
+        *rl = 0;
+        *rr = keeps_operands(op, 1) ? leaf_reg(r) : 0;
+        if (*rr == 0) {
+            gen_leaf(r, 3);
+            *rr = 3;
+        }
+        break;
+    case LEAF_LEFT:
+        gen(r);
+        *rl = keeps_operands(op, 0) ? leaf_reg(l) : 0;
+        *rr = 0;
+        if (*rl == 0) {
+            gen_leaf(l, 3);
+            *rl = 3;
+        }
+        break;
+    case LEFT_FIRST:
+        gen(l);
+        *rl = hold_temp(clobbers(r));
+        gen(r);
+        *rl = release_temp(*rl);
+        *rr = 0;
+        break;
+    default:
+        gen(r);
+        *rr = hold_temp(clobbers(l));
+        gen(l);
+        *rr = release_temp(*rr);
+        *rl = 0;
+        break;
+    }
+    // operands of a deep tree unwind without passing through gen
+    check_pc_relative();
+    return 1;
+}
+
+// binary operator, left operand pointed to by the entry, right operand follows it
+static void gen_oper(int* n, int op) {
+    int rl, rr;
+    if (!gen_operands(n, op, &rl, &rr)) {
+        return;
+    }
+    if (op >= ADDF) {
+        emit_float_oper(op, rl, rr);
+    } else {
+        emit_oper(op, rl, rr);
+    }
+}
+
+// signed division or remainder by the constant power of two d, or its
+// negation, of the value in r0. The quotient rounds toward zero, negative
+// dividends are biased by |d| - 1 before the shift
+static void emit_div_pow2(int op, int d) {
+    int k = __builtin_ctz(d);
+    if (k == 0) {
+        if (op == MOD) {
+            emit(0x2000); // movs r0,#0
+        } else if (d < 0) {
+            emit(0x4240); // negs r0,r0
+        }
+        return;
+    }
+    if (k == 1) {
+        emit(0x0fc3); // lsrs r3,r0,#31
+    } else {
+        emit(0x17c3);                   // asrs r3,r0,#31
+        emit(0x081b | ((32 - k) << 6)); // lsrs r3,r3,#32-k
+    }
+    emit(0x18c0); // adds r0,r0,r3
+    if (op == DIV) {
+        emit(0x1000 | (k << 6)); // asrs r0,r0,#k
+        if (d < 0) {
+            emit(0x4240); // negs r0,r0
+        }
+        return;
+    }
+    if (k == 8) {
+        emit(0xb2c0); // uxtb r0,r0
+    } else if (k == 16) {
+        emit(0xb280); // uxth r0,r0
+    } else {
+        emit(0x0000 | ((32 - k) << 6)); // lsls r0,r0,#32-k
+        emit(0x0800 | ((32 - k) << 6)); // lsrs r0,r0,#32-k
+    }
+    emit(0x1ac0); // subs r0,r0,r3
+}
+
+// division or remainder n, inline for a power of two divisor
+static void gen_div(int* n, int op) {
+    int d = div_pow2(n);
+    if (d == 0) {
+        gen_oper(n, op);
+        return;
+    }
+    gen((int*)Oper_entry(n).oprnd);
+    emit_div_pow2(op, d);
+}
+
+// conditions
+//
+// A condition deciding a branch sets the flags and the branch tests them
+// directly. Comparisons become a cmp, && and || chains jump out as soon as
+// their outcome is known, any other value is compared to 0.
+
+// compare the operands of relational operator n, returns the condition code
+// testing it
+static int gen_compare(int* n) {
+    static const char cond_codes[] = {0x0, 0x1, 0xa, 0xb, 0xc, 0xd}; // eq ne ge lt gt le
+    int* l = (int*)Oper_entry(n).oprnd;
+    int* r = n + Oper_words;
+    int i = ast_Tk(n), rl, rr;
+    int cc = cond_codes[(i >= EqF ? i - EqF : i - Eq)];
+    int v = (ast_Tk(r) == Num) ? Num_entry(r).val : -1;
+    if ((rl = leaf_reg(l)) != 0 && v >= 0 && v < 256) {
+        emit(0x2800 | (rl << 8) | v); // cmp rl,#v
+    } else if (rl && (rr = leaf_reg(r)) != 0) {
+        emit(0x4280 | (rr << 3) | rl); // cmp rl,rr
+    } else if (rl) {
+        gen(r);
+        emit(0x4280 | rl); // cmp rl,r0
+    } else if ((rr = leaf_reg(r)) != 0) {
+        gen(l);
+        emit(0x4280 | (rr << 3)); // cmp r0,rr
+    } else if (v >= 0 && v < 256) {
+        gen(l);
+        if (v == 0 && cc > 1) {
+            peep_barrier(); // the peep hole rules drop cmp r0,#0 when only Z is tested
+        }
+        emit(0x2800 | v); // cmp r0,#v
+    } else {
+        gen_operands(n, EQ, &rl, &rr);
+        emit(0x4280 | (rr << 3) | rl); // cmp rl,rr
+    }
+    return cc;
+}
+
+// branch on condition code cc to "to" (target - 2 as for emit_branch), or
+// when "to" is 0 through a bl placeholder added to the list *fwd
+static void emit_jump_cc(int cc, uint16_t* to, struct patch_s** fwd) {
+    struct patch_s* p;
+    if (to) {
+        if (cc == 0xe) {
+            emit_branch(to);
+        } else {
+            emit_branch_cc(to, cc);
+        }
+        return;
+    }
+    if (cc != 0xe) {
+        emit(0xd001 | ((cc ^ 1) << 8)); // b<!cc> past the bl
+    }
+    p = cc_malloc(sizeof(struct patch_s), 1);
+    p->addr = emit_call(0);
+    p->next = *fwd;
+    *fwd = p;
+}
+
+// patch the forward branches of list fwd to the code that follows
+static void patch_jumps(struct patch_s* fwd) {
+    struct patch_s* t;
+    while (fwd) {
+        t = fwd->next;
+        patch_branch(fwd->addr, e + 1);
+        cc_free(fwd);
+        fwd = t;
+    }
+}
+
+// evaluate condition n and jump when its truth is "sense", to "to" or forward
+// through the list *fwd as for emit_jump_cc
+static void gen_jump(int* n, int sense, uint16_t* to, struct patch_s** fwd) {
+    struct patch_s* skip = 0;
+    int i = ast_Tk(n);
+    switch (i) {
+    case Num:
+        if ((Num_entry(n).val != 0) == sense) {
+            emit_jump_cc(0xe, to, fwd); // always
+        }
+        return;
+    case Lor:
+    case Lan:
+        if ((i == Lor) == sense) { // either operand decides
+            gen_jump((int*)Oper_entry(n).oprnd, sense, to, fwd);
+            gen_jump(n + Oper_words, sense, to, fwd);
+            return;
+        }
+        gen_jump((int*)Oper_entry(n).oprnd, !sense, 0, &skip);
+        gen_jump(n + Oper_words, sense, to, fwd);
+        patch_jumps(skip);
+        return;
+    case Eq:
+    case Ne:
+    case Ge:
+    case Lt:
+    case Gt:
+    case Le:
+    case EqF:
+    case NeF:
+        i = gen_compare(n);
+        break;
+    default:
+        gen(n);
+        emit(0x2800); // cmp r0,#0
+        i = 0x1;      // ne
+        break;
+    }
+    emit_jump_cc(sense ? i : i ^ 1, to, fwd);
+}
+
+// effects and loops
+//
+// Statements and the increments of for loops are evaluated for their side
+// effects only: x++ skips computing the old value and register variables are
+// updated in place. A loop whose condition is constant or holds for the
+// constant its variable starts from is entered without the jump to its test at
+// the bottom. A for loop over a register variable running a few times with a
+// small body is unrolled, its test dropped.
+
+#define UNROLL_TRIPS 8  // most iterations unrolled
+#define UNROLL_NODES 64 // most AST nodes in all the copies of the body
+
+// bytes added by increment or decrement n
+static int inc_size(int* n) {
+    int t = Num_entry(n).val;
+    return (t >= PTR2) ? sizeof(int) : ((t >= PTR) ? tsize[(t - PTR) >> 2] : 1);
+}
+
+// compute v straight into register variable rj when it is a leaf or rj op
+// something, returns 0 when it isn't
+static int gen_update(int j, int* v) {
+    int i = ast_Tk(v), k;
+    int* l;
+    int* r;
+    if (is_leaf(v)) {
+        gen_leaf(v, j);
+        return 1;
+    }
+    if (i != Add && i != Sub && i != Mul && i != And && i != Or && i != Xor) {
+        return 0;
+    }
+    l = (int*)Oper_entry(v).oprnd;
+    r = v + Oper_words;
+    if (ast_Tk(l) != Load ||
+        (ast_Tk(l + Load_words) != ';' && var_reg(l + Load_words) != j)) {
+        return 0;
+    }
+    k = (ast_Tk(r) == Num) ? Num_entry(r).val : 256;
+    if ((i == Add || i == Sub) && k > -256 && k < 256) {
+        if (k < 0) {
+            k = -k;
+            i = (i == Add) ? Sub : Add;
+        }
+        emit(((i == Add) ? 0x3000 : 0x3800) | (j << 8) | k); // adds / subs rj,#k
+        return 1;
+    }
+    if ((k = leaf_reg(r)) == 0) {
+        gen(r);
+    }
+    switch (i) {
+    case Add:
+        emit(0x1800 | (k << 6) | (j << 3) | j); // adds rj,rj,rk
+        break;
+    case Sub:
+        emit(0x1a00 | (k << 6) | (j << 3) | j); // subs rj,rj,rk
+        break;
+    case Mul:
+        emit(0x4340 | (k << 3) | j); // muls rj,rk
+        break;
+    case And:
+        emit(0x4000 | (k << 3) | j); // ands rj,rk
+        break;
+    case Or:
+        emit(0x4300 | (k << 3) | j); // orrs rj,rk
+        break;
+    default:
+        emit(0x4040 | (k << 3) | j); // eors rj,rk
+        break;
+    }
+    return 1;
+}
+
+static void gen_cond(int* n, int effect);
+
+// evaluate n for its side effects only, its value is not used
+static void gen_effect(int* n) {
+    int i, j;
+    int* l;
+    if (n == 0) {
+        return;
+    }
+    i = ast_Tk(n);
+    switch (i) {
+    case '{':
+    case Link:
+        gen_effect((int*)Begin_entry(n).next);
+        gen_effect(n + Begin_words);
+        return;
+    case Cond:
+        gen_cond(n, 1);
+        return;
+    case Add:
+    case Sub:
+        l = (int*)Oper_entry(n).oprnd;
+        if ((ast_Tk(l) == Inc || ast_Tk(l) == Dec) && ast_Tk(n + Oper_words) == Num) {
+            gen_effect(l); // x++ is ++x - 1
+            return;
+        }
+        break;
+    case Inc:
+    case Dec:
+        if ((j = var_reg(n + Oper_words)) != 0 && inc_size(n) < 256) {
+            emit(((i == Inc) ? 0x3000 : 0x3800) | (j << 8) | inc_size(n)); // adds / subs rj,#k
+            cse_kill(n);
+            return;
+        }
+        break;
+    case Assign:
+        j = var_reg((int*)Assign_entry(n).right_part);
+        if (j && !assign_cast(n) && gen_update(j, n + Assign_words)) {
+            cse_kill(n);
+            return;
+        }
+        break;
+    }
+    gen(n);
+}
+
+// int variable at frame slot "slot" loaded by n
+static int loads_var(int* n, int slot) {
+    int* l = n + Load_words;
+    return ast_Tk(n) == Load && Load_entry(n).typ == INT && ast_Tk(l) == Loc &&
+           Num_entry(l).val == slot;
+}
+
+// assignment n of a constant to an int variable, its frame slot and the value
+// are returned in *slot and *v
+static int loop_start(int* n, int* slot, int* v) {
+    int *l, *r;
+    if (n == 0 || ast_Tk(n) != Assign || (Assign_entry(n).type & 0xffff) != INT ||
+        assign_cast(n)) {
+        return 0;
+    }
+    l = (int*)Assign_entry(n).right_part;
+    r = n + Assign_words;
+    if (ast_Tk(l) != Loc || ast_Tk(r) != Num) {
+        return 0;
+    }
+    *slot = Num_entry(l).val;
+    *v = Num_entry(r).val;
+    return 1;
+}
+
+// outcome of loop condition n when the variable at slot holds v, -1 unknown
+static int loop_test(int* n, int slot, int v) {
+    int i, k;
+    int* r;
+    if (n == 0) {
+        return 1; // for (;;)
+    }
+    i = ast_Tk(n);
+    if (i == Num) {
+        return Num_entry(n).val != 0;
+    }
+    r = n + Oper_words;
+    if (i < Eq || i > Le || !loads_var((int*)Oper_entry(n).oprnd, slot) || ast_Tk(r) != Num) {
+        return -1;
+    }
+    k = Num_entry(r).val;
+    switch (i) {
+    case Eq:
+        return v == k;
+    case Ne:
+        return v != k;
+    case Ge:
+        return v >= k;
+    case Lt:
+        return v < k;
+    case Gt:
+        return v > k;
+    }
+    return v <= k;
+}
+
+// constant added to the int variable at slot by loop increment n, 0 if none
+static int loop_step(int* n, int slot) {
+    int i = ast_Tk(n);
+    int *l, *r;
+    l = (int*)Oper_entry(n).oprnd;
+    if ((i == Add || i == Sub) && (ast_Tk(l) == Inc || ast_Tk(l) == Dec) &&
+        ast_Tk(n + Oper_words) == Num) {
+        n = l; // x++ is ++x - 1
+        i = ast_Tk(n);
+    }
+    if (i == Inc || i == Dec) {
+        l = n + Oper_words;
+        if (Num_entry(n).val != INT || ast_Tk(l) != Loc || Num_entry(l).val != slot) {
+            return 0;
+        }
+        return (i == Inc) ? 1 : -1;
+    }
+    if (i != Assign || (Assign_entry(n).type & 0xffff) != INT || assign_cast(n)) {
+        return 0;
+    }
+    l = (int*)Assign_entry(n).right_part;
+    if (ast_Tk(l) != Loc || Num_entry(l).val != slot) {
+        return 0;
+    }
+    n += Assign_words;
+    i = ast_Tk(n);
+    if (i != Add && i != Sub) {
+        return 0;
+    }
+    l = (int*)Oper_entry(n).oprnd;
+    r = n + Oper_words;
+    if (ast_Tk(r) != Num || ast_Tk(l) != Load ||
+        (ast_Tk(l + Load_words) != ';' && !loads_var(l, slot))) {
+        return 0;
+    }
+    return (i == Add) ? Num_entry(r).val : (int)-(unsigned)Num_entry(r).val;
+}
+
+// a loop condition that holds on entry, the jump to the test is not needed
+static int loop_enters(int* init, int* cond) {
+    int slot = 0, v = 0;
+    if (cond && ast_Tk(cond) == Num) {
+        return Num_entry(cond).val != 0;
     }
+    return loop_start(init, &slot, &v) && loop_test(cond, slot, v) == 1;
 }
 
-static uint16_t* emit_call(int n) {
+static int size_sum(int a, int b) {
+    return (a < 0 || b < 0) ? -1 : a + b;
+}
+
+// AST nodes of loop body n, -1 when it can't be repeated: it leaves the loop
+// with break or continue ("nested" loops and switches deep), has labels or
+// changes the variable at slot
+static int unroll_size(int* n, int slot, int nested) {
+    int i, k;
+    int* l;
     if (n == 0) {
-        emit(0);
-        emit(0);
-        return e - 1;
+        return 0;
     }
-    int ofs = (n - ((int)e + 6)) / 2;
-    if (ofs < -8388608 || ofs > 8388607) {
-        fatal("subroutine call too far");
+    i = ast_Tk(n);
+    if (is_binary(i) || i == Lor || i == Lan) {
+        return size_sum(1, size_sum(unroll_size((int*)Oper_entry(n).oprnd, slot, nested),
+                                    unroll_size(n + Oper_words, slot, nested)));
     }
-    int s = (ofs >> 31) & 1;
-    int i1 = ((ofs >> 22) & 1) ^ 1;
-    int i2 = ((ofs >> 21) & 1) ^ 1;
-    int j1 = s ^ i1;
-    int j2 = s ^ i2;
-    int i11 = ofs & ((1 << 11) - 1);
-    int i10 = (ofs >> 11) & ((1 << 10) - 1);
-    emit(0xf000 | (s << 10) | i10);
-    emit(0xd000 | (j1 << 13) | (j2 << 11) | i11);
-    return e - 1;
+    switch (i) {
+    case Num:
+    case NumF:
+    case ';':
+        return 1;
+    case Loc:
+        return (Num_entry(n).val == slot) ? -1 : 1;
+    case Load:
+        l = n + Load_words;
+        return (ast_Tk(l) == Loc) ? 2 : size_sum(1, unroll_size(l, slot, nested));
+    case Inc:
+    case Dec:
+        return size_sum(1, unroll_size(n + Oper_words, slot, nested));
+    case '{':
+    case Link:
+        return size_sum(unroll_size((int*)Begin_entry(n).next, slot, nested),
+                        unroll_size(n + Begin_words, slot, nested));
+    case Assign:
+        return size_sum(1, size_sum(unroll_size((int*)Assign_entry(n).right_part, slot, nested),
+                                    unroll_size(n + Assign_words, slot, nested)));
+    case CastF:
+        return size_sum(1, unroll_size((int*)CastF_entry(n).val, slot, nested));
+    case Cond:
+        k = size_sum(unroll_size((int*)Cond_entry(n).cond_part, slot, nested),
+                     unroll_size((int*)Cond_entry(n).if_part, slot, nested));
+        return size_sum(1, size_sum(k, unroll_size((int*)Cond_entry(n).else_part, slot, nested)));
+    case Func:
+    case Syscall:
+        k = 1;
+        for (l = (int*)Func_entry(n).next; l; l = (int*)ast_Tk(l)) {
+            k = size_sum(k, unroll_size(l + 1, slot, nested));
+        }
+        return k;
+    case While:
+    case DoWhile:
+        return size_sum(1, size_sum(unroll_size((int*)While_entry(n).body, slot, nested + 1),
+                                    unroll_size((int*)While_entry(n).cond, slot, nested)));
+    case For:
+        k = size_sum(unroll_size((int*)For_entry(n).init, slot, nested),
+                     unroll_size((int*)For_entry(n).body, slot, nested + 1));
+        k = size_sum(k, unroll_size((int*)For_entry(n).incr, slot, nested));
+        return size_sum(1, size_sum(k, unroll_size((int*)For_entry(n).cond, slot, nested)));
+    case Switch:
+        return size_sum(1, size_sum(unroll_size((int*)Switch_entry(n).cond, slot, nested),
+                                    unroll_size((int*)Switch_entry(n).cas, slot, nested + 1)));
+    case Case:
+        return size_sum(1, unroll_size((int*)Case_entry(n).expr, slot, nested));
+    case Default:
+    case Return:
+        return size_sum(1, unroll_size((int*)Num_entry(n).val, slot, nested));
+    case Break:
+    case Continue:
+        return nested ? 1 : -1;
+    }
+    return -1;
 }
 
-static void emit_syscall(int n, int np) {
-    const struct externs_s* p = externs + n;
-    if (p->is_printf) {
-        emit_load_immediate(0, np);
-        if (!ofn) {
-            emit_load_long_imm(3, (int)x_printf, 0);
-        } else {
-            emit_load_long_imm(3, n, 1);
+// unroll for loop n when its trip count is known and small, returns 0 if not
+static int gen_unrolled(int* n) {
+    int* init = (int*)For_entry(n).init;
+    int* cond = (int*)For_entry(n).cond;
+    int* incr = (int*)For_entry(n).incr;
+    int slot, v, step, size, trips, t;
+    if (!loop_start(init, &slot, &v) || var_index(slot) < 0 || !var_regs[var_index(slot)] ||
+        (step = loop_step(incr, slot)) == 0 ||
+        (size = unroll_size((int*)For_entry(n).body, slot, 0)) < 0) {
+        return 0;
+    }
+    for (trips = 0; (t = loop_test(cond, slot, v)) == 1; ++trips) {
+        if (trips == UNROLL_TRIPS) {
+            return 0;
         }
-    } else if (p->is_sprintf) {
-        emit_load_immediate(0, np);
-        if (!ofn) {
-            emit_load_long_imm(3, (int)x_sprintf, 0);
+        v = (int)((unsigned)v + step);
+    }
+    if (t < 0 || (size + 2) * trips > UNROLL_NODES) {
+        return 0;
+    }
+    gen_effect(init);
+    for (int i = 0; i < trips; ++i) {
+        gen_effect((int*)For_entry(n).body);
+        gen_effect(incr);
+    }
+    return 1;
+}
+
+// if else or ?: n, its parts only evaluated for their effects when "effect" is set
+static void gen_cond(int* n, int effect) {
+    struct patch_s* patch = 0;
+    uint16_t* b;
+    // jump to the false branch when the condition fails
+    gen_jump((int*)Cond_entry(n).cond_part, 0, 0, &patch);
+    if (effect) {
+        gen_effect((int*)Cond_entry(n).if_part);
+    } else {
+        gen((int*)Cond_entry(n).if_part);
+    }
+    // Add "JMP" instruction after true branch to jump over false branch.
+    // Point "b" to the jump address field to be patched later.
+    if (Cond_entry(n).else_part) {
+        b = emit_call(0);
+        pool_spot = e;
+        patch_jumps(patch);
+        if (effect) {
+            gen_effect((int*)Cond_entry(n).else_part);
         } else {
-            emit_load_long_imm(3, n, 1);
+            gen((int*)Cond_entry(n).else_part);
         }
-    } else {
-        int nparm = np & ADJ_MASK;
-        if (nparm > 4) {
-            nparm = 4;
+        patch_branch(b, e + 1);
+    } else { // else statment
+        patch_jumps(patch);
+    }
+}
+
+// place the arguments of user function call n as described for call_args,
+// except the leaves flagged in "keep", returns their number
+static int gen_args(int* n, int keep) {
+    int* a[ADJ_MASK + 1];
+    int k = call_args(n, a), held = arg_regs(a, k), pushed = 0;
+    for (int i = 4; i < k; ++i) {
+        gen(a[i]);
+        emit_push(0);
+    }
+    for (int i = (k < 4 ? k : 4) - 1; i >= 0; --i) {
+        if (is_leaf(a[i])) {
+            continue;
         }
-        while (nparm--) {
-            emit_pop(nparm);
+        gen(a[i]);
+        if (i == 0) {
+            break;
         }
-        if (!ofn) {
-            emit_load_long_imm(3, (int)p->extrn, 1);
+        if (held & (1 << i)) {
+            emit_mov(i, 0);
+            temps_live |= 1 << i;
         } else {
-            emit_load_long_imm(3, n, 1);
+            emit_push(0);
+            pushed |= 1 << i;
         }
     }
-    emit(0x4798); // blx r3
-    int nparm = np & ADJ_MASK;
-    if (p->is_printf || p->is_sprintf) {
-        emit_adjust_stack(nparm);
-    } else {
-        nparm = (nparm > 4) ? nparm - 4 : 0;
-        if (nparm) {
-            emit_adjust_stack(nparm);
+    for (int i = 1; i < 4; ++i) {
+        if (pushed & (1 << i)) {
+            emit_pop(i);
+        }
+    }
+    temps_live &= ~held;
+    for (int i = 0; i < k && i < 4; ++i) {
+        if (is_leaf(a[i]) && !(keep & (1 << i))) {
+            gen_leaf(a[i], i);
         }
     }
+    return k;
 }
 
-static void patch_branch(uint16_t* from, uint16_t* to) {
-    if (*from != 0 || *(from + 1) != 0) {
-        fatal("unexpected compiler error");
+// call user function n
+static void gen_call(int* n) {
+    int k = gen_args(n, 0);
+    emit_call(Func_entry(n).addr);
+    emit_adjust_stack((k > 4) ? k - 4 : 0);
+}
+
+// arguments of a call of the function itself passing its parameters unchanged
+static int tail_kept(int* n) {
+    int* a[ADJ_MASK + 1];
+    int k = call_args(n, a), keep = 0;
+    for (int i = 0; i < k; ++i) {
+        int* l = a[i] + Load_words;
+        if (ast_Tk(a[i]) == Load && ast_Tk(l) == Loc && Num_entry(l).val == i) {
+            keep |= 1 << i;
+        }
     }
-    uint16_t* se = e;
-    e = from - 1;
-    emit_call((int)to);
-    e = se;
+    return keep;
+}
+
+// tail call n, a jump as described for tail_call
+static void gen_tail(int* n) {
+    int to = Func_entry(n).addr, keep = (to == tail_self) ? tail_kept(n) : 0;
+    int k = gen_args(n, keep), j, ofs;
+    if (to == tail_self) {
+        for (int i = 0; i < k; ++i) { // the parameters' homes, see emit_enter
+            if (keep & (1 << i)) {
+                continue;
+            }
+            if ((j = var_index(i)) >= 0 && var_regs[j]) {
+                emit_mov(var_regs[j], i);
+            } else if (frame_kind & FRAME_PTR) {
+                emit(0x6038 | (frame_offset(i) << 4) | i); // str ri,[r7,#i*4]
+            }
+        }
+        emit_branch(tail_loop - 1);
+        tail_end = e;
+        return;
+    }
+    peep_barrier();
+    if (frame_kind & FRAME_PTR) {
+        emit(0x46bd); // mov sp, r7
+        if (frame_parms) {
+            emit(0xb000 | frame_parms); // add sp, #parms*4
+        }
+        emit(0xbc80 | saved_regs()); // pop {r4-r6,r7}
+    } else if (saved_regs()) {
+        emit(0xbc00 | saved_regs()); // pop {r4-r6}
+    }
+    if (frame_kind & FRAME_LR) {
+        emit_pop(3);
+        emit_mov(14, 3); // mov lr, r3
+    }
+    ofs = (uint16_t*)to - 2 - (e + 1);
+    if (ofs >= -1024 && ofs < 1024) {
+        emit(0xe000 | (ofs & 0x7ff)); // b to
+    } else {
+        emit_load_long_imm(3, to | 1, 0);
+        emit(0x4718); // bx r3
+    }
+    tail_end = e;
 }
 
 // AST parsing for Thumb code generatiion
 
-void gen(int* n) {
-    int i = ast_Tk(n), j, k, l;
+static void gen_node(int* n) {
+    int i = ast_Tk(n), j, k, l, v;
     uint16_t *a, *b, *c, *d, *t;
     struct ident_s* label;
     struct patch_s* patch;
 
+    gen_at = n;
     check_pc_relative();
 
     switch (i) {
     case Num:
     case NumF:
-        emit_load_immediate(0, Num_entry(n).val);
-        break; // int or float value
+    case Loc:
+        gen_leaf(n, 0);
+        break; // int or float value, or address of variable
     case Load:
+        if (is_leaf(n)) {
+            gen_leaf(n, 0);
+            break;
+        }
+        if (compound_reg && ast_Tk(n + Load_words) == ';') {
+            emit_mov(0, compound_reg); // current value of the variable assigned
+            compound_reg = 0;
+            break;
+        }
         gen(n + Load_words);                                          // load the value
         if (Num_entry(n).val > ATOM_TYPE && Num_entry(n).val < PTR) { // unreachable?
             fatal("struct copies not yet supported");
         }
-        emit_load((Num_entry(n).val >= PTR) ? LI : LC + (Num_entry(n).val >> 2));
+        emit_load((Num_entry(n).val >= PTR) ? LI : LC + (Num_entry(n).val >> 2), 0, 0);
+        break;
+    case Link:
+        gen((int*)Begin_entry(n).next); // expression replaced by fold, keep its value
         break;
-    case Loc:
-        emit_load_addr(Num_entry(n).val);
-        break; // get address of variable
     case '{':
-        gen(Begin_entry(n).next);
+        gen_effect((int*)Begin_entry(n).next);
         gen(n + Begin_words);
         break;   // parse AST expr or stmt
     case Assign: // assign the value to variables
-        gen((int*)Assign_entry(n).right_part);
-        emit_push(0);
-        gen(n + Assign_words); // xxxx
         l = Num_entry(n).val & 0xffff;
-        // Add SC/SI instruction to save value in register to variable address
-        // held on stack.
         if (l > ATOM_TYPE && l < PTR) {
             fatal("struct assign not yet supported");
         }
-        if ((Num_entry(n).val >> 16) == FLOAT && l == INT) {
-            emit_fop((int)aeabi_f2iz);
-        } else if ((Num_entry(n).val >> 16) == INT && l == FLOAT) {
-            emit_fop((int)aeabi_i2f);
+        k = (l >= PTR) ? SI : SC + (l >> 2);
+        b = (uint16_t*)Assign_entry(n).right_part; // variable address
+        if ((j = var_reg((int*)b)) != 0) {
+            compound_reg = is_compound(n + Assign_words) ? j : 0;
+            gen(n + Assign_words);
+            compound_reg = 0;
+            if (assign_cast(n)) {
+                emit_cast(assign_cast(n));
+            }
+            emit_mov(j, 0);
+            break;
+        }
+        if (assign_direct(n)) {
+            // evaluate the value first, the address needs no other register
+            gen(n + Assign_words);
+            if (assign_cast(n)) {
+                emit_cast(assign_cast(n));
+            }
+            if ((ast_Tk((int*)b) != Loc || !emit_store_frame(k, Num_entry((int*)b).val)) &&
+                (ast_Tk((int*)b) != Num || !emit_store_global(k, Num_entry((int*)b).val))) {
+                gen_leaf((int*)b, 3);
+                emit_store(k, 0, 3);
+            }
+            break;
         }
-        emit_store((l >= PTR) ? SI : SC + (l >> 2));
+        gen((int*)b); // a compound assignment value loads from this address in r0
+        j = hold_temp(assign_clobbers(n));
+        gen(n + Assign_words);
+        if (assign_cast(n)) {
+            emit_cast(assign_cast(n));
+        }
+        emit_store(k, 0, release_temp(j));
         break;
     case Inc: // increment or decrement variables
     case Dec:
-        gen(n + Oper_words);
-        emit_push(0);
-        emit_load((Num_entry(n).val == CHAR) ? LC : LI);
-        emit_push(0);
-        emit_load_immediate(
-            0, (Num_entry(n).val >= PTR2)
-                   ? sizeof(int)
-                   : ((Num_entry(n).val >= PTR) ? tsize[(Num_entry(n).val - PTR) >> 2] : 1));
-        emit_oper((i == Inc) ? ADD : SUB);
-        emit_store((Num_entry(n).val == CHAR) ? SC : SI);
-        break;
-    case Cond:                              // if else condition case
-        gen((int*)Cond_entry(n).cond_part); // condition
-        // Add jump-if-zero instruction "BZ" to jump to false branch.
-        // Point "b" to the jump address field to be patched later.
-        emit(0x2800); // cmp r0,#0
-        emit_cond_branch(e + 2, BNZ);
-        b = emit_call(0);
-        gen((int*)Cond_entry(n).if_part); // expression
-        // Patch the jump address field pointed to by "b" to hold the address
-        // of false branch. "+ 3" counts the "JMP" instruction added below.
-        //
-        // Add "JMP" instruction after true branch to jump over false branch.
-        // Point "b" to the jump address field to be patched later.
-        if (Cond_entry(n).else_part) {
-            patch_branch(b, e + 3);
-            b = emit_call(0);
-            gen((int*)Cond_entry(n).else_part);
-        } // else statment
-        // Patch the jump address field pointed to by "d" to hold the address
-        // past the false branch.
-        patch_branch(b, e + 1);
+        l = Num_entry(n).val;
+        k = inc_size(n);
+        if ((j = var_reg(n + Oper_words)) != 0) {
+            if (k < 256) {
+                emit(((i == Inc) ? 0x3000 : 0x3800) | (j << 8) | k); // adds / subs rj,#k
+            } else {
+                emit_load_immediate(2, k);
+                emit(((i == Inc) ? 0x1880 : 0x1a80) | (j << 3) | j); // adds / subs rj,rj,r2
+            }
+            emit_mov(0, j);
+            break;
+        }
+        j = 3;
+        v = (ast_Tk(n + Oper_words) == Num)
+                ? glo_offset(Num_entry(n + Oper_words).val, (l == CHAR) ? 1 : 4)
+                : -1;
+        if (v >= 0) {
+            j = glo_reg; // global addressed from the data base
+        } else if (is_leaf(n + Oper_words)) {
+            v = 0;
+            gen_leaf(n + Oper_words, 3);
+        } else {
+            v = 0;
+            gen(n + Oper_words);
+            emit_mov(3, 0);
+        }
+        emit_load_offset((l == CHAR) ? LC : LI, 0, j, v);
+        if (k < 256) {
+            emit(((i == Inc) ? 0x3000 : 0x3800) | k); // adds / subs r0,#k
+        } else {
+            emit_load_immediate(2, k);
+            emit((i == Inc) ? 0x1880 : 0x1a80); // adds / subs r0,r0,r2
+        }
+        emit_store_offset((l == CHAR) ? SC : SI, 0, j, v);
+        break;
+    case Cond: // if else condition case
+        gen_cond(n, 0);
         break;
     // operators
     /* If current token is logical OR operator:
@@ -610,172 +3074,99 @@ void gen(int* n) {
         gen(n + Oper_words);
         patch_branch(b, e + 1);
         break;
-    /* If current token is bitwise OR operator:
-     * Add "PSH" instruction to push LHS value in register to stack.
-     * Parse RHS expression.
-     * Add "OR" instruction to compute the result.
+    /* If current token is a binary operator:
+     * Evaluate the operands, holding the first one in a temporary register
+     * (see gen_oper), then add the instruction(s) to compute the result.
      */
     case Or:
-        gen((int*)Num_entry(n).val);
-        emit_push(0);
-        gen(n + Oper_words);
-        emit_oper(OR);
+        gen_oper(n, OR);
         break;
     case Xor:
-        gen((int*)Num_entry(n).val);
-        emit_push(0);
-        gen(n + Oper_words);
-        emit_oper(XOR);
+        gen_oper(n, XOR);
         break;
     case And:
-        gen((int*)Num_entry(n).val);
-        emit_push(0);
-        gen(n + Oper_words);
-        emit_oper(AND);
+        gen_oper(n, AND);
         break;
     case Eq:
-        gen((int*)Num_entry(n).val);
-        emit_push(0);
-        gen(n + Oper_words);
-        emit_oper(EQ);
+        gen_oper(n, EQ);
         break;
     case Ne:
-        gen((int*)Num_entry(n).val);
-        emit_push(0);
-        gen(n + Oper_words);
-        emit_oper(NE);
+        gen_oper(n, NE);
         break;
     case Ge:
-        gen((int*)Num_entry(n).val);
-        emit_push(0);
-        gen(n + Oper_words);
-        emit_oper(GE);
+        gen_oper(n, GE);
         break;
     case Lt:
-        gen((int*)Num_entry(n).val);
-        emit_push(0);
-        gen(n + Oper_words);
-        emit_oper(LT);
+        gen_oper(n, LT);
         break;
     case Gt:
-        gen((int*)Num_entry(n).val);
-        emit_push(0);
-        gen(n + Oper_words);
-        emit_oper(GT);
+        gen_oper(n, GT);
         break;
     case Le:
-        gen((int*)Num_entry(n).val);
-        emit_push(0);
-        gen(n + Oper_words);
-        emit_oper(LE);
+        gen_oper(n, LE);
         break;
     case Shl:
-        gen((int*)Num_entry(n).val);
-        emit_push(0);
-        gen(n + Oper_words);
-        emit_oper(SHL);
+        gen_oper(n, SHL);
         break;
     case Shr:
-        gen((int*)Num_entry(n).val);
-        emit_push(0);
-        gen(n + Oper_words);
-        emit_oper(SHR);
+        gen_oper(n, SHR);
         break;
     case Add:
-        gen((int*)Num_entry(n).val);
-        emit_push(0);
-        gen(n + Oper_words);
-        emit_oper(ADD);
+        gen_oper(n, ADD);
         break;
     case Sub:
-        gen((int*)Num_entry(n).val);
-        emit_push(0);
-        gen(n + Oper_words);
-        emit_oper(SUB);
+        gen_oper(n, SUB);
         break;
     case Mul:
-        gen((int*)Num_entry(n).val);
-        emit_push(0);
-        gen(n + Oper_words);
-        emit_oper(MUL);
+        gen_oper(n, MUL);
         break;
     case Div:
-        gen((int*)Num_entry(n).val);
-        emit_push(0);
-        gen(n + Oper_words);
-        emit_oper(DIV);
+        gen_div(n, DIV);
         break;
     case Mod:
-        gen((int*)Num_entry(n).val);
-        emit_push(0);
-        gen(n + Oper_words);
-        emit_oper(MOD);
+        gen_div(n, MOD);
         break;
     case AddF:
-        gen((int*)Num_entry(n).val);
-        emit_push(0);
-        gen(n + Oper_words);
-        emit_float_oper(ADDF);
+        gen_oper(n, ADDF);
         break;
     case SubF:
-        gen((int*)Num_entry(n).val);
-        emit_push(0);
-        gen(n + Oper_words);
-        emit_float_oper(SUBF);
+        gen_oper(n, SUBF);
         break;
     case MulF:
-        gen((int*)Num_entry(n).val);
-        emit_push(0);
-        gen(n + Oper_words);
-        emit_float_oper(MULF);
+        gen_oper(n, MULF);
         break;
     case DivF:
-        gen((int*)Num_entry(n).val);
-        emit_push(0);
-        gen(n + Oper_words);
-        emit_float_oper(DIVF);
+        gen_oper(n, DIVF);
         break;
     case EqF:
-        gen((int*)Num_entry(n).val);
-        emit_push(0);
-        gen(n + Oper_words);
-        emit_float_oper(EQF);
+        gen_oper(n, EQF);
         break;
     case NeF:
-        gen((int*)Num_entry(n).val);
-        emit_push(0);
-        gen(n + Oper_words);
-        emit_float_oper(NEF);
+        gen_oper(n, NEF);
         break;
     case GeF:
-        gen((int*)Num_entry(n).val);
-        emit_push(0);
-        gen(n + Oper_words);
-        emit_float_oper(GEF);
+        gen_oper(n, GEF);
         break;
     case LtF:
-        gen((int*)Num_entry(n).val);
-        emit_push(0);
-        gen(n + Oper_words);
-        emit_float_oper(LTF);
+        gen_oper(n, LTF);
         break;
     case GtF:
-        gen((int*)Num_entry(n).val);
-        emit_push(0);
-        gen(n + Oper_words);
-        emit_float_oper(GTF);
+        gen_oper(n, GTF);
         break;
     case LeF:
-        gen((int*)Num_entry(n).val);
-        emit_push(0);
-        gen(n + Oper_words);
-        emit_float_oper(LEF);
+        gen_oper(n, LEF);
         break;
     case CastF:
         gen((int*)CastF_entry(n).val);
         emit_cast(CastF_entry(n).way);
         break;
     case Func:
+        if (is_tail(n)) {
+            gen_tail(n);
+            break;
+        }
+        gen_call(n);
+        break;
     case Syscall:
         b = (uint16_t*)Func_entry(n).next;
         k = b ? Func_entry(n).n_parms : 0;
@@ -798,25 +3189,24 @@ void gen(int* n) {
             }
             cc_free(t);
         }
-        if (i == Syscall) {
-            emit_syscall(Func_entry(n).addr, Func_entry(n).parm_types);
-        } else if (i == Func) {
-            emit_call(Func_entry(n).addr);
-            emit_adjust_stack(Func_entry(n).n_parms);
-        }
+        emit_syscall(Func_entry(n).addr, Func_entry(n).parm_types);
         break;
     case While:
     case DoWhile:
-        if (i == While) {
+        a = 0;
+        if (i == While && !loop_enters(0, (int*)While_entry(n).cond)) {
             a = emit_call(0);
+            pool_spot = e;
         }
         b = (uint16_t*)brks;
         brks = 0;
         c = (uint16_t*)cnts;
         cnts = 0;
+        pool_before_loop(n, (int*)max(While_entry(n).body, While_entry(n).cond));
         d = e;
-        gen((int*)While_entry(n).body); // loop body
-        if (i == While) {
+        peep_barrier();
+        gen_effect((int*)While_entry(n).body); // loop body
+        if (a) {
             patch_branch(a, e + 1);
         }
         while (cnts) {
@@ -826,9 +3216,7 @@ void gen(int* n) {
             cnts = (struct patch_s*)t;
         }
         cnts = (struct patch_s*)c;
-        gen((int*)While_entry(n).cond); // condition
-        emit(0x2800);                   // cmp r0,#0
-        emit_cond_branch(d - 1, BNZ);
+        gen_jump((int*)While_entry(n).cond, 1, d - 1, 0); // condition
         while (brks) {
             t = (uint16_t*)brks->next;
             patch_branch(brks->addr, e + 1);
@@ -838,30 +3226,40 @@ void gen(int* n) {
         brks = (struct patch_s*)b;
         break;
     case For:
-        gen((int*)For_entry(n).init); // init
-        a = emit_call(0);
+        if (gen_unrolled(n)) {
+            break;
+        }
+        gen_effect((int*)For_entry(n).init); // init
+        a = 0;
+        if (!loop_enters((int*)For_entry(n).init, (int*)For_entry(n).cond)) {
+            a = emit_call(0);
+            pool_spot = e;
+        }
         b = (uint16_t*)brks;
         brks = 0;
         c = (uint16_t*)cnts;
         cnts = 0;
-        gen((int*)For_entry(n).body); // loop body
-        uint16_t* t2;
+        pool_before_loop(
+            n, (int*)max(max(For_entry(n).body, For_entry(n).cond), For_entry(n).incr));
+        d = e;
+        peep_barrier();
+        gen_effect((int*)For_entry(n).body); // loop body
         while (cnts) {
             t = (uint16_t*)cnts->next;
-            t2 = e;
             patch_branch(cnts->addr, e + 1);
             cc_free(cnts);
             cnts = (struct patch_s*)t;
         }
         cnts = (struct patch_s*)c;
-        gen((int*)For_entry(n).incr); // increment
-        patch_branch(a, e + 1);
+        gen_effect((int*)For_entry(n).incr); // increment
+        if (a) {
+            patch_branch(a, e + 1);
+        }
         if (For_entry(n).cond) {
-            gen((int*)For_entry(n).cond); // condition
-            emit(0x2800);                 // cmp r0,#0
-            emit_cond_branch(a, BNZ);
+            gen_jump((int*)For_entry(n).cond, 1, d - 1, 0); // condition
         } else {
-            emit_branch(a);
+            emit_branch(d - 1);
+            pool_spot = e;
         }
         while (brks) {
             t = (uint16_t*)brks->next;
@@ -873,55 +3271,57 @@ void gen(int* n) {
         break;
     case Switch:
         gen((int*)Switch_entry(n).cond); // condition
-        emit_push(0);
-        a = ecas;
-        ecas = emit_call(0);
+        a = emit_call(0);                // JMP dispatch
+        pool_spot = e;
         b = (uint16_t*)brks;
+        c = (uint16_t*)cases;
         d = def;
-        def = 0;
         brks = 0;
+        cases = 0;
+        def = 0;
         gen((int*)Switch_entry(n).cas); // case statment
-        // deal with no default inside switch case
-        patch_branch(ecas, (def ? def : e) + 1);
+        if (!brks || brks->addr != e - 1) {
+            patch = cc_malloc(sizeof(struct patch_s), 1); // JMP over the dispatch
+            patch->addr = emit_call(0);
+            patch->next = brks;
+            brks = patch;
+            pool_spot = e;
+        }
+        patch_branch(a, e + 1);
+        gen_switch(def);
         while (brks) {
             t = (uint16_t*)brks->next;
             patch_branch((uint16_t*)(brks->addr), e + 1);
             cc_free(brks);
             brks = (struct patch_s*)t;
         }
-        emit_adjust_stack(1);
         brks = (struct patch_s*)b;
+        cases = (struct patch_s*)c;
         def = d;
         break;
     case Case:
-        a = 0;
-        patch_branch(ecas, e + 1);
-        gen((int*)Num_entry(n).val); // condition
-        // if (*(e - 1) != IMM) // ***FIX***
-        //    fatal("case label not a numeric literal");
-        emit(0x9b00); // ldr r3, [sp, #0]
-        emit(0x4298); // cmp r0, r3
-        emit_cond_branch(e + 2, BZ);
-        ecas = emit_call(0);
-        if (*((int*)Case_entry(n).expr) == Switch) {
-            a = ecas;
-        }
-        gen((int*)Case_entry(n).expr); // expression
-        if (a != 0) {
-            ecas = a;
-        }
+        place_pool();
+        peep_barrier();
+        patch = cc_malloc(sizeof(struct patch_s), 1);
+        patch->addr = e + 1;
+        patch->val = Num_entry((int*)Case_entry(n).next).val; // case label
+        patch->next = cases;
+        cases = patch;
+        gen_effect((int*)Case_entry(n).expr); // expression
         break;
     case Break:
         patch = cc_malloc(sizeof(struct patch_s), 1);
         patch->addr = emit_call(0);
         patch->next = brks;
         brks = patch;
+        pool_spot = e;
         break;
     case Continue:
         patch = cc_malloc(sizeof(struct patch_s), 1);
         patch->next = cnts;
         patch->addr = emit_call(0);
         cnts = patch;
+        pool_spot = e;
         break;
     case Goto:
         label = (struct ident_s*)Num_entry(n).val;
@@ -933,29 +3333,59 @@ void gen(int* n) {
         } else {
             emit_branch((uint16_t*)label->val - 1);
         }
+        pool_spot = e;
         break;
     case Default:
-        def = e;
+        place_pool();
+        peep_barrier();
+        def = e + 1;
         gen((int*)Num_entry(n).val);
         break;
     case Return:
         if (Num_entry(n).val) {
             gen((int*)Num_entry(n).val);
         }
-        emit_leave();
+        if (!is_tail((int*)Num_entry(n).val)) {
+            emit_leave();
+        }
+        pool_spot = e;
         break;
     case Enter:
-        emit_enter(Num_entry(n).val);
-        gen(n + Enter_words);
-        emit_leave();
+        gen_enter = n;
+        temps_live = 0;
+        temps_saved = saved_temps(n + Enter_words, 0);
+        alloc_vars(n);
+        ntails = tail_loops = 0;
+        tail_self = (int)(e + 1);
+        find_tails(n + Enter_words, 1, frame_escapes(n + Enter_words));
+        frame_kind = frame_uses(n);
+        frame_parms = (frame_kind & FRAME_PTR) ? Enter_entry(n).parms : 0;
+        if (frame_kind || saved_regs()) {
+            frame_kind |= FRAME_LR;
+        }
+        peep_barrier(); // function entry
+        emit_enter(Enter_entry(n).val);
+        if (tail_loops) {
+            tail_loop = e;
+            peep_barrier(); // loop head
+        }
+        gen_effect(n + Enter_words);
+        if (!ends_with_leave()) {
+            emit_leave();
+        }
         patch_pc_relative(0);
+        nvars = 0;
+        consts_live = 0;
+        ncse = cse_saved = glo_reg = 0;
         break;
     case Label: // target of goto
         label = (struct ident_s*)Num_entry(n).val;
         if (label->class != 0) {
             fatal("duplicate label definition");
         }
+        place_pool();
         d = e;
+        peep_barrier();
         while (label->forward) {
             struct patch_s* l = (struct patch_s*)label->forward;
             patch_branch(l->addr, d + 1);
@@ -971,3 +3401,19 @@ void gen(int* n) {
         }
     }
 }
+
+// generate n, or move its value from the register keeping it
+void gen(int* n) {
+    int c = cse_saved ? cse_number(n, 0) : -1;
+    if (c >= 0 && cse_held(c)) {
+        emit_mov(0, cse_regs[c]);
+        return;
+    }
+    gen_node(n);
+    if (c >= 0) {
+        emit_mov(cse_regs[c], 0);
+        cse_at[c] = e;
+    } else if (cse_saved) {
+        cse_kill(n);
+    }
+}
@@ -4,7 +4,9 @@
 #include <stdint.h>
 
 void gen(int* n);
+void gen_var(int n);
 void emit(uint16_t n);
 void emit_word(uint32_t n);
+int encode_call(uint16_t* at, int to, uint16_t* bl);
 
 #endif
@@ -60,12 +60,13 @@ static void show_externals(int i) {
 
 void cc_help(char* lib) {
     if (!lib) {
-        printf("Usage: cc [-s] [-u] [-n] [-h [lib]] [-Dsymbol[=integer]]\n"
+        printf("Usage: cc [-s] [-u] [-n] [-m] [-h [lib]] [-Dsymbol[=integer]]\n"
                "          [-o exename] filename.c\n"
                "  -s      display disassembly and quit.\n"
                "  -o      name of executable output file.\n"
                "  -u      treat char type as unsigned.\n"
                "  -n      turn off peep-hole optimization\n"
+               "  -m      report the program's peak heap usage.\n"
                "  -Dsymbol[=integer]\n"
                "          define symbol for limited pre-processor.\n"
                "  -h      show compiler help and list libraries.\n"
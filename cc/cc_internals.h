@@ -18,8 +18,15 @@
 #define DATA_BYTES (16 * K)       // data segment size
 #define TEXT_BYTES (16 * K)       // code segment size
 #define TS_TBL_BYTES (2 * K)      // type size table size (released at run time)
+#ifndef AST_TBL_BYTES
 #define AST_TBL_BYTES (32 * K)    // abstract syntax table size (released at run time)
+#endif
 #define MEMBER_DICT_BYTES (4 * K) // struct member table size (released at run time)
+#define SYM_HASH_BITS 8           // symbol table hash buckets (released at run time)
+#define SYM_HASH_BYTES ((1 << SYM_HASH_BITS) * sizeof(struct ident_s*))
+
+// symbol table bucket for an identifier hash
+#define SYM_HASH(h) (((unsigned)(h) * 0x9e3779b1u) >> (32 - SYM_HASH_BITS))
 
 #define CTLC 3 // control C ascii character
 
@@ -54,13 +61,14 @@ struct reloc_s {
 
 extern struct reloc_s* relocs UDATA; // relocation list root
 extern int nrelocs UDATA;            // relocation list size
+extern int pool_bytes UDATA;         // literal pool bytes, with the branches over them
 
 extern char *p UDATA, *lp UDATA;                       // current position in source code
 extern char* data UDATA;                               // data/bss pointer
 extern char* data_base UDATA;                          // data/bss pointer
 extern int* base_sp UDATA;                             // stack
 extern uint16_t *e UDATA, *le UDATA, *text_base UDATA; // current position in emitted code
-extern uint16_t* ecas UDATA;                           // case statement patch-up pointer
+extern struct patch_s* cases UDATA;                    // case labels of the current switch
 extern int* ncas UDATA;                                // case statement patch-up pointer
 extern uint16_t* def UDATA;                            // default statement patch-up pointer
 extern struct patch_s* brks UDATA;                     // break statement patch-up pointer
@@ -87,6 +95,7 @@ extern int lineno UDATA;              // current line number
 extern int src_opt UDATA;             // print source and assembly flag
 extern int nopeep_opt UDATA;          // turn off peep-hole optimization
 extern int uchar_opt UDATA;           // use unsigned character variables
+extern int heap_opt UDATA;            // report the program's heap usage
 extern int* n UDATA;                  // current position in emitted abstract syntax tree
                                       // With an AST, the compiler is not limited to generate
                                       // code on the fly with parsing.
@@ -105,6 +114,7 @@ extern char* src_base UDATA;          // source code region
 // identifier
 struct ident_s {
     struct ident_s* next;
+    struct ident_s* chain; // next identifier in the same hash bucket
     int tk;     // type-id or keyword
     int hash;   // keyword hash
     char* name; // name of this identifier (not NULL terminated)
@@ -117,12 +127,14 @@ struct ident_s {
     int val, hval;        // address of symbol
     int etype, hetype;    // extended type info. different meaning for funcs.
     uint16_t* forward;    // forward call patch address
+    int* inline_body;     // AST of a function whose calls are inlined, 0 if not
     uint8_t inserted : 1; // inserted in disassembler table
 };
 
 // symbol table
-extern struct ident_s* id UDATA;       // currently parsed identifier
-extern struct ident_s* sym_base UDATA; // symbol table (simple list of identifiers)
+extern struct ident_s* id UDATA;        // currently parsed identifier
+extern struct ident_s* sym_base UDATA;  // symbol table (simple list of identifiers)
+extern struct ident_s** sym_hash UDATA; // symbol table hash buckets
 
 // struct member list entry
 struct member_s {
@@ -1,4 +1,5 @@
 #include <stdarg.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -9,11 +10,133 @@
 
 __attribute__((__noreturn__)) void run_fatal(const char* fmt, ...);
 
-static int* malloc_list UDATA; // list of allocated memory blocks
+// Compiler allocations are carved from an arena of chunks by bumping a
+// pointer and are released together by cc_free_all(). Freeing the block
+// allocated last gives its space back, other frees wait for the release.
+//
+// Once the compiler buffers are released the arena is closed and the running
+// program allocates from size class pools carved from the data segment space
+// its globals leave unused, then from chunks taken from the heap when that is
+// used up. Freed pool blocks go on the free list of their class. Larger blocks
+// come from the heap and are kept on a doubly linked list, so that freeing one
+// unlinks it at once and cc_free_all() can release those still allocated.
+//
+// Every block is preceded by a word telling where it came from: the arena
+// block size with bit 0 set, the pool class shifted left 2 with bit 1 set,
+// and bit 0 too while the block is free, or the size of a list block shifted
+// left 2 after the list links.
+
+#define ARENA_CHUNK (4 * K) // arena growth, larger blocks get a chunk of their own
+#define POOL_CLASSES 6      // pool blocks of 8, 16, 32, 64, 128 and 256 bytes
+#define POOL_CHUNK (2 * K)  // pool space taken from the heap at a time
+
+static int* malloc_list UDATA;             // list of allocated memory blocks
+static int* pool_chunks UDATA;             // list of pool chunks taken from the heap
+static int* arena_list UDATA;              // list of arena chunks
+static char* arena_top UDATA;              // next free byte of the current chunk
+static char* arena_end UDATA;              // end of the current chunk
+static int arena_closed UDATA;             // compiler buffers released, allocate for the program
+static int* pool_free[POOL_CLASSES] UDATA; // free blocks of each pool class
+static char* pool_top UDATA;               // next unused byte of the pool space
+static char* pool_end UDATA;               // end of the pool space
+static int heap_bytes UDATA;               // bytes allocated by the program, with headers
+static int heap_blocks UDATA;              // blocks allocated by the program
+static int heap_peak_bytes UDATA;          // most bytes allocated at once
+static int heap_peak_blocks UDATA;         // most blocks allocated at once
+
+static void* arena_malloc(int l, int die) {
+    int n = ((l + 3) & ~3) + 4;
+    int* p = (int*)arena_top;
+    if (arena_end - arena_top < n) {
+        int sz = (n > ARENA_CHUNK / 4) ? n : ARENA_CHUNK;
+        int* c = malloc(sz + 4);
+        if (!c) {
+            if (die) {
+                run_fatal("out of memory");
+            } else {
+                return 0;
+            }
+        }
+        c[0] = (int)arena_list;
+        arena_list = c;
+        p = c + 1;
+        if (sz > n) {
+            arena_end = (char*)p + sz;
+            arena_top = (char*)p + n;
+        }
+    } else {
+        arena_top += n;
+    }
+    p[0] = n | 1;
+    if (die) {
+        memset(p + 1, 0, l);
+    }
+    return p + 1;
+}
+
+static void heap_count(int n, int blocks) {
+    heap_bytes += n;
+    heap_blocks += blocks;
+    if (heap_bytes > heap_peak_bytes) {
+        heap_peak_bytes = heap_bytes;
+    }
+    if (heap_blocks > heap_peak_blocks) {
+        heap_peak_blocks = heap_blocks;
+    }
+}
+
+static int* pool_malloc(int l) {
+    int c = 0;
+    while ((8 << c) < l + 4) {
+        if (++c == POOL_CLASSES) {
+            return 0;
+        }
+    }
+    int* p = pool_free[c];
+    if (p) {
+        pool_free[c] = (int*)p[1];
+    } else {
+        if (pool_end - pool_top < (8 << c)) {
+            int* ch = malloc(POOL_CHUNK + 4);
+            if (!ch) {
+                return 0;
+            }
+            ch[0] = (int)pool_chunks;
+            pool_chunks = ch;
+            pool_top = (char*)(ch + 1);
+            pool_end = pool_top + POOL_CHUNK;
+        }
+        p = (int*)pool_top;
+        pool_top += 8 << c;
+    }
+    p[0] = (c << 2) | 2;
+    heap_count(8 << c, 1);
+    return p + 1;
+}
+
+// hand the space from base to end to the program's pools
+void cc_heap_init(char* base, char* end) {
+    pool_top = (char*)(((int)base + 7) & ~7);
+    pool_end = end;
+}
+
+void cc_heap_report(void) {
+    printf("heap  peak %d bytes, %d blocks\n", heap_peak_bytes, heap_peak_blocks);
+}
 
 // local memory management functions
 void* cc_malloc(int l, int die) {
-    int* p = malloc(l + 4);
+    if (!arena_closed) {
+        return arena_malloc(l, die);
+    }
+    int* p = pool_malloc(l);
+    if (p) {
+        if (die) {
+            memset(p, 0, l);
+        }
+        return p;
+    }
+    p = malloc(l + 12);
     if (!p) {
         if (die) {
             run_fatal("out of memory");
@@ -22,11 +145,17 @@ void* cc_malloc(int l, int die) {
         }
     }
     if (die) {
-        memset(p + 1, 0, l);
+        memset(p + 3, 0, l);
     }
     p[0] = (int)malloc_list;
+    p[1] = 0;
+    p[2] = l << 2;
+    if (malloc_list) {
+        malloc_list[1] = (int)p;
+    }
     malloc_list = p;
-    return p + 1;
+    heap_count(l + 12, 1);
+    return p + 3;
 }
 
 void cc_free(void* p) {
@@ -34,22 +163,57 @@ void cc_free(void* p) {
         run_fatal("freeing a NULL pointer");
     }
     int* p2 = (int*)p - 1;
-    int* last = (int*)&malloc_list;
-    int* pi = (int*)(*last);
-    while (pi) {
-        if (pi == p2) {
-            last[0] = pi[0];
-            free(pi);
-            return;
+    if (p2[0] & 2) {
+        int c = p2[0] >> 2;
+        if ((p2[0] & 1) || c < 0 || c >= POOL_CLASSES) {
+            run_fatal("corrupted memory");
+        }
+        p2[0] |= 1;
+        p2[1] = (int)pool_free[c];
+        pool_free[c] = p2;
+        heap_count(-(8 << c), -1);
+        return;
+    }
+    if (p2[0] & 1) {
+        if ((char*)p2 + (p2[0] & ~1) == arena_top) {
+            arena_top = (char*)p2;
         }
-        last = pi;
-        pi = (int*)pi[0];
+        return;
     }
-    run_fatal("corrupted memory");
+    p2 -= 2;
+    int* next = (int*)p2[0];
+    int* prev = (int*)p2[1];
+    if ((prev ? (int*)prev[0] : malloc_list) != p2 || (next && (int*)next[1] != p2)) {
+        run_fatal("corrupted memory");
+    }
+    if (prev) {
+        prev[0] = (int)next;
+    } else {
+        malloc_list = next;
+    }
+    if (next) {
+        next[1] = (int)prev;
+    }
+    heap_count(-((p2[2] >> 2) + 12), -1);
+    free(p2);
 }
 
 void cc_free_all(void) {
     while (malloc_list) {
-        cc_free(malloc_list + 1);
+        cc_free(malloc_list + 3);
+    }
+    while (pool_chunks) {
+        int* c = pool_chunks;
+        pool_chunks = (int*)c[0];
+        free(c);
+    }
+    while (arena_list) {
+        int* c = arena_list;
+        arena_list = (int*)c[0];
+        free(c);
     }
+    arena_top = arena_end = NULL;
+    arena_closed = 1;
+    memset(pool_free, 0, sizeof(pool_free));
+    pool_top = pool_end = NULL;
 }
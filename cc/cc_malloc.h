@@ -4,5 +4,7 @@
 void* cc_malloc(int nbytes, int zero);
 void cc_free(void* m);
 void cc_free_all(void);
+void cc_heap_init(char* base, char* end);
+void cc_heap_report(void);
 
 #endif
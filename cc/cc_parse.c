@@ -5,6 +5,7 @@
 #include "cc_malloc.h"
 #include "cc_ops.h"
 #include "cc_gen.h"
+#include "cc_fold.h"
 #include <stdio.h>
 
 /* parse next token
@@ -31,8 +32,8 @@ void next() {
             tk = (tk << 6) + (p - pp); // hash plus symbol length
             // hash value is used for fast comparison. Since it is inaccurate,
             // we have to validate the memory content as well.
-            id = sym_base;
-            for (id = sym_base; id; id = id->next) { // find one free slot in table
+            struct ident_s** bucket = sym_hash + SYM_HASH(tk);
+            for (id = *bucket; id; id = id->chain) { // search the hash bucket
                 if (tk == id->hash &&                // if token is found (hash match), overwrite
                     !memcmp(id->name, pp, p - pp)) {
                     tk = id->tk;
@@ -46,10 +47,13 @@ void next() {
             id->name = pp;
             id->hash = tk;
             id->forward = 0;
+            id->inline_body = 0;
             id->inserted = 0;
             tk = id->tk = Id; // token type identifier
             id->next = sym_base;
             sym_base = id;
+            id->chain = *bucket;
+            *bucket = id;
             return;
         }
         /* Calculate the constant */
@@ -411,6 +415,17 @@ int extern_search(char* name)
     return -1;
 }
 
+// frame slot of a local variable or parameter in words from r7. The first four
+// parameters arrive in r0-r3 and are pushed by the prologue, r7 points at them.
+// The others stay where the caller pushed them, past the registers saved on entry.
+static int frame_slot(struct ident_s* d) {
+    int r = (loc - 1 < 4) ? loc - 1 : 4; // parameters passed in registers
+    if (d->class == Par) {
+        return (d->val < 4) ? d->val : loc - d->val + r;
+    }
+    return loc - d->val;
+}
+
 // verify binary operations are legal
 void typecheck(int op, int tl, int tr) {
     int pt = 0, it = 0, st = 0;
@@ -471,6 +486,321 @@ bool is_power_of_2(int n) {
     return ((n - 1) & n) == 0;
 }
 
+// function inlining
+//
+// The AST of a function stays in place after its code is generated. Calls to
+// short functions made of expression statements, ending with the only return,
+// are replaced by a copy of that AST. Functions making calls are left alone,
+// their own calls cost as much as the one saved and can't recurse. Parameters
+// only read take constant and variable arguments directly, the others become
+// locals of the caller assigned the arguments ahead of the body. Only calls
+// compiled while a quarter of the code segment and of the AST space is left
+// are inlined.
+
+#define INLINE_NODES 12 // largest function body inlined, in AST nodes, pool loads twice
+#define INLINE_PARMS 4  // most parameters, those passed in registers
+#define INLINE_TEMPS 32 // caller locals listed as register variables
+
+static int inline_parms UDATA;                // parameters of the function inlined
+static int inline_pure UDATA;                 // its body stores only to parameters and globals
+static int inline_written UDATA;              // parameters stored to or addressed, a bit each
+static int inline_types[INLINE_PARMS] UDATA;  // type of each parameter, 0 if unknown
+static int* inline_args[INLINE_PARMS] UDATA;  // argument read in place of a parameter
+static int inline_slots[INLINE_PARMS] UDATA;  // caller frame slot holding a parameter
+static int inline_temps[INLINE_TEMPS] UDATA;  // caller frame slots added for parameters
+static int ntemps UDATA;                      // slots listed
+
+static int inline_sum(int a, int b) {
+    return (a < 0 || b < 0) ? -1 : a + b;
+}
+
+// note a use of the parameter addressed by l, -1 if l is a local of the function
+static int inline_parm(int* l, int typ, int written) {
+    int p = Double_entry(l).v1;
+    if (p < 0 || p >= inline_parms) {
+        return -1;
+    }
+    if (typ) {
+        inline_types[p] = typ;
+    }
+    if (written) {
+        inline_written |= 1 << p;
+    }
+    return 1;
+}
+
+// n is the address of a global or an offset from it, storing there leaves the
+// caller's locals alone
+static int inline_global(int* n) {
+    int* r = n + Oper_words;
+    if (ast_Tk(n) == Add) {
+        return inline_global((int*)Oper_entry(n).oprnd) || inline_global(r);
+    }
+    return ast_Tk(n) == Num && Num_entry(n).val >= (int)data_base &&
+           Num_entry(n).val < (int)(data_base + DATA_BYTES);
+}
+
+// number of nodes of an inlined expression or statement, -1 if it can't be copied
+static int inline_scan(int* s) {
+    int i, k, *a;
+    if (s == 0) {
+        return 0;
+    }
+    i = ast_Tk(s);
+    if ((i >= Or && i <= Mod) || (i >= AddF && i <= LeF) || i == Lor || i == Lan) {
+        k = inline_sum(1, inline_scan((int*)Oper_entry(s).oprnd));
+        return inline_sum(k, inline_scan(s + Oper_words));
+    }
+    switch (i) {
+    case Num:
+    case NumF: // counted twice when loaded from the literal pool
+        return (Num_entry(s).val >= -255 && Num_entry(s).val <= 255) ? 1 : 2;
+    case ';':
+        return 0;
+    case Loc: // address of a parameter
+        return inline_parm(s, 0, 1);
+    case Load:
+    case Inc:
+    case Dec:
+        a = s + Load_words;
+        if (ast_Tk(a) == Loc) {
+            return inline_parm(a, Load_entry(s).typ, i != Load);
+        }
+        if (i != Load && !inline_global(a)) {
+            inline_pure = 0;
+        }
+        return inline_sum(1, inline_scan(a));
+    case '{':
+    case Link:
+        return inline_sum(inline_scan((int*)Begin_entry(s).next), inline_scan(s + Begin_words));
+    case Assign:
+        a = (int*)Assign_entry(s).right_part;
+        if (ast_Tk(a) == Loc) {
+            k = inline_parm(a, Assign_entry(s).type & 0xffff, 1);
+        } else {
+            inline_pure &= inline_global(a);
+            k = inline_scan(a);
+        }
+        return inline_sum(inline_sum(1, k), inline_scan(s + Assign_words));
+    case CastF:
+        return inline_sum(1, inline_scan((int*)CastF_entry(s).val));
+    case Cond:
+        k = inline_sum(1, inline_scan((int*)Cond_entry(s).cond_part));
+        k = inline_sum(k, inline_scan((int*)Cond_entry(s).if_part));
+        return inline_sum(k, inline_scan((int*)Cond_entry(s).else_part));
+    }
+    return -1; // statements other than expressions, or calls costing what inlining saves
+}
+
+// split the body of a function into its statements and returned value, and scan
+// them, returns their number of nodes or -1
+static int inline_split(int* body, int** stmts, int** value) {
+    int* r = body + Begin_words;
+    *stmts = body;
+    *value = 0;
+    if (ast_Tk(body) == '{' && ast_Tk(r) == Return) {
+        *stmts = (int*)Begin_entry(body).next;
+        *value = (int*)Double_entry(r).v1;
+    }
+    inline_pure = 1;
+    inline_written = 0;
+    for (int p = 0; p < INLINE_PARMS; ++p) {
+        inline_types[p] = 0;
+    }
+    return inline_sum(inline_scan(*stmts), inline_scan(*value));
+}
+
+// body of the function defined by the AST at n, if its calls can be inlined
+static int* inline_def(int* n) {
+    int* body = n + Enter_words;
+    int *stmts, *value, k;
+    if (Enter_entry(n).val || loc - 1 > INLINE_PARMS) {
+        return 0; // locals or parameters on the stack
+    }
+    for (struct ident_s* v = sym_base; v; v = v->next) {
+        if (v->class == Par &&
+            ((v->type & 3) || !(v->type == INT || v->type == FLOAT || v->type >= PTR))) {
+            return 0;
+        }
+    }
+    inline_parms = loc - 1;
+    k = inline_split(body, &stmts, &value);
+    return (k >= 0 && k <= INLINE_NODES) ? body : 0;
+}
+
+// argument a is a constant or an address, or a load from one, evaluated by a
+// call after the other arguments
+static int inline_leaf(int* a) {
+    switch (ast_Tk(a)) {
+    case Num:
+    case NumF:
+    case Loc:
+        return 1;
+    case Load:
+        return inline_leaf(a + Load_words);
+    }
+    return 0;
+}
+
+// copy a constant, the address of a local or its value, read in place of a
+// parameter
+static void inline_arg(int* a) {
+    int* l = a + Load_words;
+    if (ast_Tk(a) == Loc) {
+        ast_Loc(Double_entry(a).v1);
+    } else if (ast_Tk(a) == Load) {
+        ast_Loc(Double_entry(l).v1);
+        ast_Load(Load_entry(a).typ);
+    } else {
+        ast_Num(Num_entry(a).val);
+        Num_entry(n).tk = ast_Tk(a);
+        Num_entry(n).valH = Num_entry(a).valH;
+    }
+}
+
+// copy the expression or statement s of the function inlined, linked operands
+// are copied ahead of the inline ones that must end up right after their entry
+static int* inline_copy(int* s) {
+    int i, *a, *b, *c;
+    if (s == 0) {
+        return 0;
+    }
+    i = ast_Tk(s);
+    if ((i >= Or && i <= Mod) || (i >= AddF && i <= LeF) || i == Lor || i == Lan) {
+        a = inline_copy((int*)Oper_entry(s).oprnd);
+        inline_copy(s + Oper_words);
+        ast_Oper((int)a, i);
+        return n;
+    }
+    switch (i) {
+    case Num:
+    case NumF:
+        ast_Num(Num_entry(s).val);
+        Num_entry(n).tk = i;
+        Num_entry(n).valH = Num_entry(s).valH;
+        break;
+    case Loc: // parameter kept in a local of the caller
+        ast_Loc(inline_slots[Double_entry(s).v1]);
+        break;
+    case ';':
+        ast_End();
+        break;
+    case Load:
+    case Inc:
+    case Dec:
+        a = s + Load_words;
+        if (ast_Tk(a) == Loc && (b = inline_args[Double_entry(a).v1]) != 0) {
+            inline_arg(b);
+            break;
+        }
+        inline_copy(a);
+        ast_Load(Load_entry(s).typ);
+        Load_entry(n).tk = i;
+        break;
+    case '{':
+    case Link:
+        a = inline_copy((int*)Begin_entry(s).next);
+        inline_copy(s + Begin_words);
+        ast_Begin(a);
+        Begin_entry(n).tk = i;
+        break;
+    case Assign:
+        a = inline_copy((int*)Assign_entry(s).right_part);
+        inline_copy(s + Assign_words);
+        ast_Assign((int)a, Assign_entry(s).type);
+        break;
+    case CastF:
+        a = inline_copy((int*)CastF_entry(s).val);
+        ast_CastF(CastF_entry(s).way, (int)a);
+        break;
+    case Cond:
+        a = inline_copy((int*)Cond_entry(s).cond_part);
+        b = inline_copy((int*)Cond_entry(s).if_part);
+        c = inline_copy((int*)Cond_entry(s).else_part);
+        ast_Cond((int)c, (int)b, (int)a);
+        break;
+    }
+    return n;
+}
+
+// evaluate argument a, linked from the entries just pushed
+static void inline_value(int* a) {
+    ast_End();
+    ast_Begin(a);
+}
+
+// sequence c followed by the entry just pushed
+static int* inline_seq(int* c) {
+    if (c) {
+        ast_Begin(c);
+    }
+    return n;
+}
+
+// replace the call of function d with the arguments chained from b by its body,
+// returns 0 if the call is kept
+static int inline_call(struct ident_s* d, int* b) {
+    int *args[INLINE_PARMS], *stmts, *value, *a, *c, *l, p, t, leaf;
+    if (e > text_base + TEXT_BYTES / sizeof(*e) * 3 / 4 ||
+        n < ast + AST_TBL_BYTES / sizeof(*n) / 4) {
+        return 0;
+    }
+    inline_parms = d->etype & ADJ_MASK;
+    if (inline_split(d->inline_body, &stmts, &value) < 0) {
+        return 0;
+    }
+    for (p = inline_parms - 1, a = b; p >= 0; --p, a = (int*)ast_Tk(a)) {
+        args[p] = a + Single_words;
+        inline_args[p] = 0;
+        if (((inline_written >> p) & 1) && inline_types[p] == 0) {
+            return 0; // only its address is used
+        }
+    }
+    // like the arguments of a call, the last ones are evaluated first and the
+    // constants and variables after the others
+    c = 0;
+    for (leaf = 0; leaf < 2; ++leaf) {
+        for (p = inline_parms - 1; p >= 0; --p) {
+            a = args[p];
+            l = a + Load_words;
+            t = inline_types[p];
+            if (inline_leaf(a) != leaf) {
+                continue;
+            }
+            if (t == 0) { // unused, evaluated for its side effects
+                if (!leaf) {
+                    inline_value(a);
+                    c = inline_seq(c);
+                }
+            } else if (leaf && !((inline_written >> p) & 1) &&
+                       (ast_Tk(a) != Load || (inline_pure && ast_Tk(l) == Loc))) {
+                inline_args[p] = a;
+            } else {
+                inline_slots[p] = loc - ++ld;
+                if (ntemps < INLINE_TEMPS) {
+                    inline_temps[ntemps++] = inline_slots[p];
+                }
+                ast_Loc(inline_slots[p]);
+                l = n;
+                inline_value(a);
+                ast_Assign((int)l, (t << 16) | t);
+                c = inline_seq(c);
+            }
+        }
+    }
+    if (ast_Tk(stmts) != ';') {
+        inline_copy(stmts);
+        c = inline_seq(c);
+    }
+    if (value) {
+        inline_copy(value);
+        inline_seq(c);
+    } else if (c == 0) {
+        ast_End();
+    }
+    return 1;
+}
+
 /* expression parsing
  * lev represents an operator.
  * because each operator `token` is arranged in order of priority,
@@ -595,7 +925,9 @@ void expr(int lev) {
             }
             next();
             // function or system call id
-            ast_Func(tt, t, d->val, (int)b, d->class);
+            if (!d->inline_body || !inline_call(d, b)) {
+                ast_Func(tt, t, d->val, (int)b, d->class);
+            }
             ty = d->type;
         }
         // enumeration, only enums have ->class == Num
@@ -613,7 +945,7 @@ void expr(int lev) {
             switch (d->class) {
             case Loc:
             case Par:
-                ast_Loc(loc - d->val);
+                ast_Loc(frame_slot(d));
                 break;
             case Glo:
                 ast_Num(d->val);
@@ -1396,13 +1728,7 @@ void expr(int lev) {
                     Num_entry(b).val /= Num_entry(n).val;
                     n = b;
                 } else {
-                    if (ast_Tk(n) == Num && Num_entry(n).val > 0 &&
-                        is_power_of_2(Num_entry(n).val)) {
-                        Num_entry(n).val = __builtin_popcount(Num_entry(n).val - 1);
-                        ast_Oper((int)b, Shr); // 2^n
-                    } else {
-                        ast_Oper((int)b, Div);
-                    }
+                    ast_Oper((int)b, Div);
                 }
                 ty = INT;
             }
@@ -1423,12 +1749,7 @@ void expr(int lev) {
                 Num_entry(b).val %= Num_entry(n).val;
                 n = b;
             } else {
-                if (ast_Tk(n) == Num && Num_entry(n).val > 0 && is_power_of_2(Num_entry(n).val)) {
-                    --Num_entry(n).val;
-                    ast_Oper((int)b, And); // 2^n
-                } else {
-                    ast_Oper((int)b, Mod);
-                }
+                ast_Oper((int)b, Mod);
             }
             ty = INT;
             break;
@@ -1970,15 +2291,17 @@ void stmt(int ctx) {
                 dd->etype = ddetype;
                 uint16_t* se;
                 if (tk == ';') { // check for prototype
+                    // jump to the function once defined, r0-r3 hold arguments
                     se = e;
                     if (!((int)e & 2)) {
                         emit(0x46c0); // nop
                     }
-                    emit(0x4800); // ldr r0, [pc, #0]
-                    emit(0xe001); // b.n 1
+                    emit(0xb403); // push {r0,r1}
+                    emit(0x4801); // ldr  r0, [pc, #4]
+                    emit(0x9001); // str  r0, [sp, #4]
+                    emit(0xbd01); // pop  {r0,pc}
                     dd->forward = e;
                     emit_word(0);
-                    emit(0x4700); // bx  r0
                 } else {          // function with body
                     if (tk != '{') {
                         fatal("bad function definition");
@@ -2007,10 +2330,23 @@ void stmt(int ctx) {
                     if (rtf == 0 && rtt != -1) {
                         fatal("expecting return value");
                     }
-                    ast_Enter(ld - loc);
+                    ast_Enter(ld - loc, (loc - 1 < 4) ? loc - 1 : 4);
+                    // scalar variables the code generator may keep in registers
+                    for (struct ident_s* v = sym_base; v; v = v->next) {
+                        if ((v->class == Loc || v->class == Par) && !(v->type & 3) &&
+                            (v->type == INT || v->type == FLOAT || v->type >= PTR)) {
+                            gen_var(frame_slot(v));
+                        }
+                    }
+                    for (i = 0; i < ntemps; ++i) {
+                        gen_var(inline_temps[i]);
+                    }
+                    ntemps = 0;
                     ncas = 0;
                     se = e;
+                    fold(n);
                     gen(n);
+                    dd->inline_body = inline_def(n);
                 }
                 if (src_opt) {
                     printf("%d: %.*s\n", lineno, p - lp, lp);
@@ -2034,6 +2370,11 @@ void stmt(int ctx) {
                         id = id->next;
                     } else if (id->class == Label) { // clear id for next func
                         struct ident_s* id3 = id;
+                        struct ident_s** bucket = sym_hash + SYM_HASH(id3->hash);
+                        while (*bucket != id3) {
+                            bucket = &(*bucket)->chain;
+                        }
+                        *bucket = id3->chain;
                         id = id->next;
                         cc_free(id3);
                         id2->next = id;
@@ -2099,7 +2440,7 @@ void stmt(int ctx) {
                                 ast_End();
                             }
                             b = n;
-                            ast_Loc(loc - dd->val);
+                            ast_Loc(frame_slot(dd));
                             a = n;
                             i = ty;
                             expr(Assign);
@@ -2,147 +2,62 @@
 #include "cc_internals.h"
 
 // peep hole optimizer
+//
+// The rewrite rules are written as Thumb instructions in cc_peep.rules and
+// compiled at build time by peepgen.py into pattern, mask and replacement
+// tables. Bits cleared in a mask are immediate fields carried over to the
+// replacement by the field map.
 
-// FROM:		   	  TO:
-// mov  r0, r7		  mov  r3,r7
-// push {r0}		  movs r0,#n
-// movs r0,#n
-// pop  {r3}
-
-static uint16_t pat0[] = {0x4638, 0xb401, 0x2000, 0xbc08};
-static uint16_t msk0[] = {0xffff, 0xffff, 0xff00, 0xffff};
-static uint16_t rep0[] = {0x463b, 0x2000};
-
-// ldr  r0,[r0,#n0]   ldr  r3,[r0,#n0]
-// push {r0}		  movs r0,#n1
-// movs r0, #n1
-// pop  {r3}
-
-static uint16_t pat1[] = {0x6800, 0xb401, 0x2000, 0xbc08};
-static uint16_t msk1[] = {0xff00, 0xffff, 0xff00, 0xffff};
-static uint16_t rep1[] = {0x6803, 0x2000};
-
-// movs r0,#n         mov  r0,r7
-// rsbs r0,r0		  subs r0,#n
-// add  r0,r7
-
-static uint16_t pat2[] = {0x2000, 0x4240, 0x4438};
-static uint16_t msk2[] = {0xff00, 0xffff, 0xffff};
-static uint16_t rep2[] = {0x4638, 0x3800};
-
-// push {r0}
-// pop {r0}
-
-static uint16_t pat3[] = {0xb401, 0xbc01};
-static uint16_t msk3[] = {0xffff, 0xffff};
-static uint16_t rep3[0] = {};
-
-// movs r0,#n          mov r1,#n
-// push {r0}
-// pop  {r1}
-
-static uint16_t pat4[] = {0x2000, 0xb401, 0xbc02};
-static uint16_t msk4[] = {0xff00, 0xffff, 0xffff};
-static uint16_t rep4[] = {0x2100};
-
-// mov  r0,r7          mov  r3,r7
-// subs r0,#n0         subs r3,#n0
-// push {r0}           movs r0,#n1
-// movs r0,#n1
-// pop  {r3}
-
-static uint16_t pat5[] = {0x4638, 0x3800, 0xb401, 0x2000, 0xbc08};
-static uint16_t msk5[] = {0xffff, 0xff00, 0xffff, 0xff00, 0xffff};
-static uint16_t rep5[] = {0x463b, 0x3b00, 0x2000};
-
-// mov  r0,r7          ldr  r0,[r7,#0]
-// ldr  r0,[r0,#0]
-
-static uint16_t pat6[] = {0x4638, 0x6800};
-static uint16_t msk6[] = {0xffff, 0xffff};
-static uint16_t rep6[] = {0x6838};
-
-// movs r0,#4			lsls r0,r3,#2
-// muls r0,r3
-
-static uint16_t pat7[] = {0x2004, 0x4358};
-static uint16_t msk7[] = {0xffff, 0xffff};
-static uint16_t rep7[] = {0x0098};
-
-// mov  r0,r7          subs r3,r7,#4
-// subs r0,#4          movs r0,#n1
-// push {r0}
-// movs r0,#n1
-// pop  {r3}
-
-static uint16_t pat8[] = {0x4638, 0x3804, 0xb401, 0x2000, 0xbc08};
-static uint16_t msk8[] = {0xffff, 0xffff, 0xffff, 0xff00, 0xffff};
-static uint16_t rep8[] = {0x1f3b, 0x2000};
-
-// mov  r0, r7         sub r0,r7,#4
-// subs r0, #4
-
-static uint16_t pat9[] = {0x4638, 0x3804};
-static uint16_t msk9[] = {0xffff, 0xffff};
-static uint16_t rep9[] = {0x1f38};
+struct subs {
+    int8_t from;  // pattern instruction holding the field
+    int8_t to;    // replacement instruction receiving it
+    int8_t lshft; // field shift, negative shifts right
+};
 
-// push {r0}            mov  r1,r0
-// movs r0,#n           movs r0,#n
-// pop  {r1}
+struct segs {
+    uint8_t n_pats;
+    uint8_t n_reps;
+    const uint16_t* pat;
+    const uint16_t* msk;
+    const uint16_t* rep;
+    struct subs map[2];
+};
 
-static uint16_t pat10[] = {0xb401, 0x2000, 0xbc02};
-static uint16_t msk10[] = {0xffff, 0xff00, 0xffff};
-static uint16_t rep10[] = {0x4601, 0x2000};
+#include "cc_peep_rules.h"
 
-// push {r0}            mov r1,r0
-// pop  {r1}
+#define numof(a) (sizeof(a) / sizeof(a[0]))
 
-static uint16_t pat11[] = {0xb401, 0xbc02};
-static uint16_t msk11[] = {0xffff, 0xffff};
-static uint16_t rep11[] = {0x4601};
+static const struct segs segments[] = {PEEP_SEGMENTS};
 
-// movs r0,#n           ldr r0,[r7,#n]
-// add  r0,r7
-// ldr  r0,[r0,#0]
+static uint16_t* barrier UDATA; // last instruction excluded from pattern matches
 
-static uint16_t pat12[] = {0x2000, 0x4438, 0x6800};
-static uint16_t msk12[] = {0xff83, 0xffff, 0xffff};
-static uint16_t rep12[] = {0x6838};
+// Patterns are indexed by the high byte of their last instruction, which is
+// the opcode just emitted when they can match. Chains hold segment index + 1
+// in table order, patterns whose last mask leaves the high byte open are
+// chained on the extra entry and tried along with every opcode.
 
-struct subs {
-    int8_t from;
-    int8_t to;
-    int8_t lshft;
-};
+#define PEEP_ANY 256
 
-#define numof(a) (sizeof(a) / sizeof(a[0]))
+static uint16_t peep_head[PEEP_ANY + 1] UDATA; // first pattern for an opcode
+static uint16_t peep_next[numof(segments)] UDATA; // next pattern for the same opcode
 
-static const struct segs {
-    uint8_t n_pats;
-    uint8_t n_reps;
-    uint16_t* pat;
-    uint16_t* msk;
-    uint16_t* rep;
-    struct subs map[2];
-} segments[] = {{numof(pat0), numof(rep0), pat0, msk0, rep0, {{2, 1, 0}, {-1, -1, 0}}},
-                {numof(pat1), numof(rep1), pat1, msk1, rep1, {{0, 0, 0}, {2, 1, 0}}},
-                {numof(pat2), numof(rep2), pat2, msk2, rep2, {{0, 1, 0}, {-1, -1, 0}}},
-                {numof(pat3), numof(rep3), pat3, msk3, rep3, {{-1, -1, 0}, {-1, -1, 0}}},
-                {numof(pat4), numof(rep4), pat4, msk4, rep4, {{0, 0, 0}, {-1, -1, 0}}},
-                {numof(pat8), numof(rep8), pat8, msk8, rep8, {{3, 1, 0}, {-1, -1, 0}}},
-                {numof(pat5), numof(rep5), pat5, msk5, rep5, {{1, 1, 0}, {3, 2, 0}}},
-                {numof(pat6), numof(rep6), pat6, msk6, rep6, {{-1, -1, 0}, {-1, -1, 0}}},
-                {numof(pat7), numof(rep7), pat7, msk7, rep7, {{-1, -1, 0}, {-1, -1, 0}}},
-                {numof(pat9), numof(rep9), pat9, msk9, rep9, {{-1, -1, 0}, {-1, -1, 0}}},
-                {numof(pat10), numof(rep10), pat10, msk10, rep10, {{1, 1, 0}, {-1, -1, 0}}},
-                {numof(pat11), numof(rep11), pat11, msk11, rep11, {{-1, -1, 0}, {-1, -1, 0}}},
-                {numof(pat12), numof(rep12), pat12, msk12, rep12, {{0, 0, 4}, {-1, -1, 0}}}};
+void peep_init(void) {
+    for (int i = numof(segments) - 1; i >= 0; --i) {
+        const struct segs* s = &segments[i];
+        int k = PEEP_ANY;
+        if ((s->msk[s->n_pats - 1] & 0xff00) == 0xff00) {
+            k = s->pat[s->n_pats - 1] >> 8;
+        }
+        peep_next[i] = peep_head[k];
+        peep_head[k] = i + 1;
+    }
+}
 
 static int peep_hole(const struct segs* s) {
     uint16_t rslt[8];
     int l = s->n_pats;
     uint16_t* pe = (e - l) + 1;
-    if (pe < text_base) {
+    if (pe < text_base || pe <= barrier) {
         return 0;
     }
     for (int i = 0; i < l; i++) {
@@ -160,16 +75,47 @@ static int peep_hole(const struct segs* s) {
         if (s->map[i].from < 0) {
             break;
         }
-        pe[s->map[i].to] |= rslt[s->map[i].from] << s->map[i].lshft;
+        int v = rslt[s->map[i].from];
+        int k = s->map[i].lshft;
+        pe[s->map[i].to] |= (k >= 0) ? v << k : v >> -k;
     }
     e += l;
     return 1;
 }
 
+// exclude the code emitted so far, a branch target or data follows
+void peep_barrier(void) {
+    barrier = e;
+}
+
+// nothing emitted since the last barrier
+int peep_fenced(void) {
+    return barrier == e;
+}
+
+// a barrier was set since the instruction at "at" was emitted
+int peep_fenced_since(uint16_t* at) {
+    return barrier >= at;
+}
+
 void peep(void) {
+    int i, j;
 restart:
-    for (int i = 0; i < numof(segments); ++i) {
-        if (peep_hole(&segments[i])) {
+    if (e < text_base) {
+        return;
+    }
+    i = peep_head[*e >> 8];
+    j = peep_head[PEEP_ANY];
+    while (i || j) {
+        int k;
+        if (j == 0 || (i && i < j)) {
+            k = i;
+            i = peep_next[i - 1];
+        } else {
+            k = j;
+            j = peep_next[j - 1];
+        }
+        if (peep_hole(&segments[k - 1])) {
             goto restart;
         }
     }
@@ -1,6 +1,12 @@
 #ifndef _CC_PEEP_H_
 #define _CC_PEEP_H_
 
+#include <stdint.h>
+
+void peep_init(void);
 void peep(void);
+void peep_barrier(void);
+int peep_fenced(void);
+int peep_fenced_since(uint16_t* at);
 
 #endif
@@ -57,6 +57,7 @@ enum {
     // 200
     Dot,
     Arrow,
-    Bracket
+    Bracket,
+    Link // expression folded in place of a larger one, Begin entry (hidden)
     // clang-format on
 };
@@ -0,0 +1,333 @@
+#!/usr/bin/env python3
+#
+# peepgen.py: compile the peep hole rules in cc_peep.rules into the pattern
+# tables included by cc_peep.c
+#
+#   peepgen.py cc_peep.rules cc_peep_rules.h
+#
+# A rule is a sequence of Thumb instructions, a line holding "=>", and the
+# instructions that replace them. Rules are separated by blank lines and tried
+# in file order. Immediate operands written as #name are holes matching any
+# value the instructions can encode, their value is carried to the same name
+# in the replacement. A rule may be preceded by
+#
+#   @each NAME[,NAME...] VALUE[,VALUE...] ...
+#
+# to instantiate it once for each group of values, the names are replaced as
+# whole words in the rule text. Several @each lines instantiate the rule for
+# every combination of their values.
+
+import itertools
+import re
+import sys
+
+MAX_PATS = 8  # rslt[] size in cc_peep.c
+MAX_MAPS = 2  # segs.map[] size in cc_peep.c
+
+
+class RuleError(Exception):
+    pass
+
+
+ALU = {
+    "ands": 0x0, "eors": 0x1, "lsls": 0x2, "lsrs": 0x3, "asrs": 0x4, "adcs": 0x5,
+    "sbcs": 0x6, "rors": 0x7, "tst": 0x8, "negs": 0x9, "cmp": 0xA, "cmn": 0xB,
+    "orrs": 0xC, "muls": 0xD, "bics": 0xE, "mvns": 0xF,
+}
+
+# load / store with immediate offset: opcode, access size
+MEM_IMM = {
+    "str": (0x6000, 4), "ldr": (0x6800, 4), "strb": (0x7000, 1), "ldrb": (0x7800, 1),
+    "strh": (0x8000, 2), "ldrh": (0x8800, 2),
+}
+
+# load / store with register offset
+MEM_REG = {
+    "str": 0x5000, "strh": 0x5200, "strb": 0x5400, "ldrsb": 0x5600,
+    "ldr": 0x5800, "ldrh": 0x5A00, "ldrb": 0x5C00, "ldrsh": 0x5E00,
+}
+
+EXTEND = {"sxth": 0xB200, "sxtb": 0xB240, "uxth": 0xB280, "uxtb": 0xB2C0}
+
+REGS = {"r%d" % i: i for i in range(8)}
+REGS.update({"r8": 8, "r9": 9, "r10": 10, "r11": 11, "r12": 12, "sp": 13, "lr": 14})
+
+
+class Insn:
+    """An encoded instruction, fixed bits plus at most one immediate hole."""
+
+    def __init__(self, text):
+        self.text = text
+        self.bits = 0
+        self.hole = None  # (name, bit position, width, scale)
+
+    def imm(self, op, pos, width, scale=1):
+        if op[0] == "hole":
+            if self.hole:
+                raise RuleError("more than one hole in '%s'" % self.text)
+            self.hole = (op[1], pos, width, scale)
+            return
+        v = op[1]
+        if v % scale or v < 0 or v // scale >= (1 << width):
+            raise RuleError("immediate out of range in '%s'" % self.text)
+        self.bits |= (v // scale) << pos
+
+
+def parse_operands(s):
+    ops = []
+    for tok in re.findall(r"\[[^\]]*\]|\{[^}]*\}|[^,\s][^,]*", s):
+        tok = tok.strip()
+        if tok.startswith("["):
+            inner = [t.strip() for t in tok[1:-1].split(",")]
+            ops.append(("mem", [parse_operands(t)[0] for t in inner]))
+        elif tok.startswith("{"):
+            ops.append(("list", [t.strip() for t in tok[1:-1].split(",")]))
+        elif tok.startswith("#"):
+            v = tok[1:]
+            if re.fullmatch(r"-?(0x[0-9a-fA-F]+|\d+)", v):
+                ops.append(("imm", int(v, 0)))
+            elif re.fullmatch(r"[A-Za-z_]\w*", v):
+                ops.append(("hole", v))
+            else:
+                raise RuleError("bad immediate '%s'" % tok)
+        elif tok in REGS:
+            ops.append(("reg", REGS[tok]))
+        elif tok == "pc":
+            raise RuleError("pc relative instructions can't be moved")
+        else:
+            raise RuleError("bad operand '%s'" % tok)
+    return ops
+
+
+def lo(op, text):
+    if op[0] != "reg" or op[1] > 7:
+        raise RuleError("low register expected in '%s'" % text)
+    return op[1]
+
+
+def is_imm(op):
+    return op[0] in ("imm", "hole")
+
+
+def encode(text):
+    m = re.fullmatch(r"(\w+)\s*(.*)", text)
+    if not m:
+        raise RuleError("bad instruction '%s'" % text)
+    mn, ops = m.group(1), parse_operands(m.group(2))
+    sig = "".join({"reg": "r", "imm": "i", "hole": "i", "mem": "m", "list": "l"}[o[0]] for o in ops)
+    ins = Insn(text)
+
+    if mn in ("b", "bl", "blx", "bx") or re.fullmatch(r"b(eq|ne|cs|cc|mi|pl|vs|vc|hi|ls|ge|lt|gt|le)", mn):
+        raise RuleError("branches can't be part of a rule")
+    if mn == "movs" and sig == "ri":
+        ins.bits = 0x2000 | lo(ops[0], text) << 8
+        ins.imm(ops[1], 0, 8)
+    elif mn == "movs" and sig == "rr":
+        ins.bits = lo(ops[1], text) << 3 | lo(ops[0], text)
+    elif mn == "mov" and sig == "rr":
+        d, s = ops[0][1], ops[1][1]
+        ins.bits = 0x4600 | (d & 8) << 4 | s << 3 | (d & 7)
+    elif mn == "cmp" and sig == "ri":
+        ins.bits = 0x2800 | lo(ops[0], text) << 8
+        ins.imm(ops[1], 0, 8)
+    elif mn in ("adds", "subs") and sig == "ri":
+        ins.bits = (0x3000 if mn == "adds" else 0x3800) | lo(ops[0], text) << 8
+        ins.imm(ops[1], 0, 8)
+    elif mn in ("adds", "subs") and sig == "rri":
+        ins.bits = (0x1C00 if mn == "adds" else 0x1E00) | lo(ops[1], text) << 3 | lo(ops[0], text)
+        ins.imm(ops[2], 6, 3)
+    elif mn in ("adds", "subs") and sig == "rrr":
+        ins.bits = (0x1800 if mn == "adds" else 0x1A00) | lo(ops[2], text) << 6 | lo(ops[1], text) << 3
+        ins.bits |= lo(ops[0], text)
+    elif mn == "add" and sig == "rr":
+        d, s = ops[0][1], ops[1][1]
+        ins.bits = 0x4400 | (d & 8) << 4 | s << 3 | (d & 7)
+    elif mn in ("add", "sub") and sig == "ri" and ops[0] == ("reg", 13):
+        ins.bits = 0xB000 if mn == "add" else 0xB080
+        ins.imm(ops[1], 0, 7, 4)
+    elif mn in ("lsls", "lsrs", "asrs") and sig == "rri":
+        ins.bits = {"lsls": 0x0000, "lsrs": 0x0800, "asrs": 0x1000}[mn]
+        ins.bits |= lo(ops[1], text) << 3 | lo(ops[0], text)
+        ins.imm(ops[2], 6, 5)
+    elif mn == "rsbs" and sig == "rri" and ops[2] == ("imm", 0):
+        ins.bits = 0x4000 | ALU["negs"] << 6 | lo(ops[1], text) << 3 | lo(ops[0], text)
+    elif mn == "muls" and sig == "rrr" and ops[0] == ops[2]:
+        ins.bits = 0x4000 | ALU["muls"] << 6 | lo(ops[1], text) << 3 | lo(ops[0], text)
+    elif mn in ALU and sig == "rr":
+        ins.bits = 0x4000 | ALU[mn] << 6 | lo(ops[1], text) << 3 | lo(ops[0], text)
+    elif mn in EXTEND and sig == "rr":
+        ins.bits = EXTEND[mn] | lo(ops[1], text) << 3 | lo(ops[0], text)
+    elif mn in MEM_IMM and sig == "rm" and ops[1][1][0] == ("reg", 13) and mn in ("ldr", "str"):
+        addr = ops[1][1]
+        ins.bits = (0x9800 if mn == "ldr" else 0x9000) | lo(ops[0], text) << 8
+        if len(addr) > 1:
+            ins.imm(addr[1], 0, 8, 4)
+    elif mn in MEM_REG and sig == "rm" and len(ops[1][1]) == 2 and ops[1][1][1][0] == "reg":
+        addr = ops[1][1]
+        ins.bits = MEM_REG[mn] | lo(addr[1], text) << 6 | lo(addr[0], text) << 3 | lo(ops[0], text)
+    elif mn in MEM_IMM and sig == "rm":
+        addr = ops[1][1]
+        if len(addr) > 2 or (len(addr) == 2 and not is_imm(addr[1])):
+            raise RuleError("bad address in '%s'" % text)
+        op, size = MEM_IMM[mn]
+        ins.bits = op | lo(addr[0], text) << 3 | lo(ops[0], text)
+        if len(addr) == 2:
+            ins.imm(addr[1], 6, 5, size)
+    elif mn in ("push", "pop") and sig == "l":
+        ins.bits = 0xB400 if mn == "push" else 0xBC00
+        for r in ops[0][1]:
+            if r == ("lr" if mn == "push" else "pc"):
+                ins.bits |= 0x100
+            elif r in REGS and REGS[r] < 8:
+                ins.bits |= 1 << REGS[r]
+            else:
+                raise RuleError("bad register list in '%s'" % text)
+    elif mn == "nop" and sig == "":
+        ins.bits = 0x46C0
+    else:
+        raise RuleError("unsupported instruction '%s'" % text)
+    return ins
+
+
+def value_bits(hole):
+    _, _, width, scale = hole
+    low = scale.bit_length() - 1
+    return low, low + width
+
+
+def compile_rule(pat_text, rep_text):
+    pat = [encode(t) for t in pat_text]
+    rep = [encode(t) for t in rep_text]
+    if not pat or len(pat) > MAX_PATS:
+        raise RuleError("pattern must have 1 to %d instructions" % MAX_PATS)
+    if len(rep) > len(pat):
+        raise RuleError("replacement is longer than the pattern")
+
+    # value bits of each hole that every one of its fields can hold
+    holes = {}
+    for i in pat + rep:
+        if i.hole:
+            lo_bit, hi_bit = value_bits(i.hole)
+            h = holes.get(i.hole[0], (lo_bit, hi_bit))
+            holes[i.hole[0]] = (max(h[0], lo_bit), min(h[1], hi_bit))
+    src = {}
+    for k, i in enumerate(pat):
+        if i.hole:
+            if i.hole[0] in src:
+                raise RuleError("hole '%s' used twice in the pattern" % i.hole[0])
+            src[i.hole[0]] = k
+
+    msk = []
+    for i in pat:
+        m = 0xFFFF
+        if i.hole:
+            name, pos, width, scale = i.hole
+            lo_bit, hi_bit = holes[name]
+            if lo_bit >= hi_bit:
+                raise RuleError("no value of '%s' fits every use" % name)
+            shift = pos - (scale.bit_length() - 1)
+            for b in range(lo_bit, hi_bit):
+                m &= ~(1 << (b + shift))
+        if i.bits & m == 0:
+            raise RuleError("'%s' matches an unpatched call placeholder" % i.text)
+        msk.append(m)
+
+    maps = []
+    for k, i in enumerate(rep):
+        if i.hole:
+            name, pos, width, scale = i.hole
+            if name not in src:
+                raise RuleError("hole '%s' not set by the pattern" % name)
+            f = pat[src[name]].hole
+            shift = (pos - (scale.bit_length() - 1)) - (f[1] - (f[3].bit_length() - 1))
+            maps.append((src[name], k, shift))
+    if len(maps) > MAX_MAPS:
+        raise RuleError("more than %d holes in the replacement" % MAX_MAPS)
+    return [i.bits for i in pat], msk, [i.bits for i in rep], maps
+
+
+def read_rules(fn):
+    rules = []
+    each = []
+    block = []
+
+    def flush():
+        nonlocal each, block
+        if not block:
+            if each:
+                raise RuleError("%s: @each without a rule" % fn)
+            return
+        lineno = block[0][0]
+        text = "\n".join(t for _, t in block)
+        for groups in itertools.product(*[[(names, v) for v in values] for names, values in each]):
+            t = text
+            for names, g in groups:
+                for name, v in zip(names, g):
+                    t = re.sub(r"\b%s\b" % re.escape(name), v, t)
+            lines = t.split("\n")
+            if lines.count("=>") != 1:
+                raise RuleError("%s:%d: rule needs one '=>' line" % (fn, lineno))
+            k = lines.index("=>")
+            rules.append((lineno, lines[:k], lines[k + 1:]))
+        each = []
+        block = []
+
+    for lineno, line in enumerate(open(fn), 1):
+        line = line.split("//")[0].strip()
+        line = re.sub(r"\s+", " ", line)
+        if not line:
+            flush()
+        elif line.startswith("@each "):
+            if block:
+                raise RuleError("%s:%d: @each inside a rule" % (fn, lineno))
+            w = line.split()[1:]
+            names = w[0].split(",")
+            values = [v.split(",") if len(names) > 1 else [v] for v in w[1:]]
+            if not values or any(len(v) != len(names) for v in values):
+                raise RuleError("%s:%d: bad @each" % (fn, lineno))
+            each.append((names, values))
+        else:
+            block.append((lineno, line))
+    flush()
+    return rules
+
+
+def hexs(a):
+    return ", ".join("0x%04x" % v for v in a)
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit("usage: peepgen.py rules_file header_file")
+    fn = sys.argv[1]
+    try:
+        rules = read_rules(fn)
+        out = ["// generated from %s by peepgen.py, do not edit" % fn.split("/")[-1], ""]
+        segs = []
+        for k, (lineno, pat_text, rep_text) in enumerate(rules):
+            try:
+                pat, msk, rep, maps = compile_rule(pat_text, rep_text)
+            except RuleError as x:
+                raise RuleError("%s:%d: %s" % (fn, lineno, x))
+            out += ["// " + t for t in pat_text] + ["// =>"] + ["// " + t for t in rep_text]
+            out.append("static const uint16_t pat%d[] = {%s};" % (k, hexs(pat)))
+            out.append("static const uint16_t msk%d[] = {%s};" % (k, hexs(msk)))
+            if rep:
+                out.append("static const uint16_t rep%d[] = {%s};" % (k, hexs(rep)))
+            else:
+                out.append("static const uint16_t rep%d[1] = {0};" % k)
+            out.append("")
+            maps += [(-1, -1, 0)] * (MAX_MAPS - len(maps))
+            segs.append("    {%d, %d, pat%d, msk%d, rep%d, {%s}}," % (
+                len(pat), len(rep), k, k, k, ", ".join("{%d, %d, %d}" % m for m in maps)))
+        out.append("#define PEEP_SEGMENTS \\")
+        out += [s + " \\" for s in segs]
+        out.append("")
+    except (RuleError, OSError) as x:
+        sys.exit("peepgen: %s" % x)
+    with open(sys.argv[2], "w") as f:
+        f.write("\n".join(out) + "\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,118 @@
+// Linux build of the compiler. Compiles a source file into a pshell
+// executable without a pico attached:
+//
+//   cc_host -o hello hello.c
+//
+// The code and data segments are mapped at their firmware address so the
+// executable runs on the pico like the one cc -o writes there. Externs are
+// referenced by their index in the externs table and resolved by the loader.
+// Not knowing the firmware's addresses, cc_host calls every extern through a
+// literal pool word where the pico reaches those resident in SRAM with a bl,
+// so the two executables aren't always byte for byte the same.
+
+#define _GNU_SOURCE
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/personality.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "io.h"
+#include "pico_host.h"
+#include "cc.h"
+
+// __StackLimit is placed at its firmware address by the linker (--defsym)
+extern char __StackLimit[];
+#define SEGMENT_BYTES (32 * 1024)
+
+uint32_t term_cols = 80;
+uint32_t term_rows = 24;
+
+char* full_path(const char* name) { return (char*)name; }
+
+int fs_file_open(lfs_file_t* file, const char* path, int flags) {
+    const char* mode = "rb";
+    if (flags & LFS_O_WRONLY) {
+        mode = (flags & LFS_O_APPEND) ? "ab" : "wb";
+    }
+    file->fp = fopen(path, mode);
+    return file->fp ? LFS_ERR_OK : LFS_ERR_NOENT;
+}
+
+int fs_file_close(lfs_file_t* file) {
+    if (file->fp) {
+        fclose(file->fp);
+        file->fp = NULL;
+    }
+    return LFS_ERR_OK;
+}
+
+lfs_ssize_t fs_file_read(lfs_file_t* file, void* buffer, lfs_size_t size) {
+    return fread(buffer, 1, size, file->fp);
+}
+
+lfs_ssize_t fs_file_write(lfs_file_t* file, const void* buffer, lfs_size_t size) {
+    return fwrite(buffer, 1, size, file->fp);
+}
+
+lfs_soff_t fs_file_seek(lfs_file_t* file, lfs_soff_t off, int whence) {
+    if (fseek(file->fp, off, whence)) {
+        return LFS_ERR_IO;
+    }
+    return ftell(file->fp);
+}
+
+int fs_dir_close(lfs_dir_t* dir) { return LFS_ERR_OK; }
+
+lfs_ssize_t fs_getattr(const char* path, uint8_t type, void* buffer, lfs_size_t size) {
+    return LFS_ERR_NOENT;
+}
+
+int fs_setattr(const char* path, uint8_t type, const void* buffer, lfs_size_t size) {
+    return LFS_ERR_OK;
+}
+
+// The compiler stores pointers in int sized AST cells, so everything it
+// touches (heap, stack, code and data segments) must sit below 2 GB. The heap
+// grows from a randomized start that may end up right below the segments,
+// malloc then falls back to mappings above 4 GB. Without randomization it
+// starts after the bss with room to grow.
+
+static ucontext_t main_ctx, cc_ctx;
+static int cc_argc, cc_rslt;
+static char** cc_argv;
+
+static void run_cc(void) { cc_rslt = cc(0, cc_argc, cc_argv); }
+
+int main(int argc, char** argv) {
+    int pers = personality(0xffffffff);
+    if (pers != -1 && !(pers & ADDR_NO_RANDOMIZE) &&
+        personality(pers | ADDR_NO_RANDOMIZE) != -1) {
+        execv("/proc/self/exe", argv);
+    }
+    if (mmap(__StackLimit, SEGMENT_BYTES, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0) != __StackLimit) {
+        perror("mmap segments");
+        return 1;
+    }
+    mallopt(M_MMAP_MAX, 0);
+    size_t stk_size = 1024 * 1024;
+    void* stk = mmap(NULL, stk_size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    if (stk == MAP_FAILED) {
+        perror("mmap stack");
+        return 1;
+    }
+    cc_argc = argc;
+    cc_argv = argv;
+    getcontext(&cc_ctx);
+    cc_ctx.uc_stack.ss_sp = stk;
+    cc_ctx.uc_stack.ss_size = stk_size;
+    cc_ctx.uc_link = &main_ctx;
+    makecontext(&cc_ctx, run_cc, 0);
+    swapcontext(&main_ctx, &cc_ctx);
+    return cc_rslt ? 1 : 0;
+}
@@ -0,0 +1,1258 @@
+// Cortex-M0+ Thumb simulator running pshell executables on Linux:
+//
+//   ccsim [-c] [-l max_instructions] hello [args]
+//
+// Loads an executable written by cc -o (header, text, data, relocations),
+// runs it from its entry point and services calls to the externs and the
+// floating point helpers with host shims. Instructions are counted with the
+// M0+ cycle timings, shims with an estimate of the SDK function's cost.
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico_host.h"
+#include "io.h"
+#include "cc_internals.h"
+#include "cc_malloc.h"
+#include "cc_wraps.h"
+
+// the compiler's externs table, executables refer to its entries by index
+#include "cc_defs.h"
+static const struct externs_s sim_externs[] = {
+#include "cc_extrns.h"
+};
+
+// free is the compiler's own, it is only taken by address here
+void cc_free(void* m) {}
+
+#define RAM_BASE 0x20000000u
+#define RAM_BYTES (264 * K)
+#define TEXT_BASE 0x20038000u // __StackLimit, see misc/pshell.ld
+#define DATA_BASE (TEXT_BASE + TEXT_BYTES)
+#define STACK_TOP (RAM_BASE + RAM_BYTES)
+#define STACK_LIMIT (DATA_BASE + DATA_BYTES) // the stack grows down to the data segment
+#define HEAP_BASE RAM_BASE
+#define HEAP_BYTES (192 * K)
+
+// relocated external and helper functions are given addresses in an
+// unmapped region, a branch there is a call to a host shim
+#define EXTERN_BASE 0xf0000000u
+#define FOP_BASE 0xf1000000u
+// functions called with a bl relocation must be within reach of the code
+#define NEAR_EXTERN_BASE 0x20800000u
+#define NEAR_FOP_BASE 0x20900000u
+#define NEAR_END 0x20a00000u
+#define EXIT_ADDR 0xfffffff0u
+// the SIO's integer divider, the only peripheral the generated code uses
+#define SIO_BASE 0xd0000000u
+#define DIV_UDIVIDEND 0x60
+#define DIV_UDIVISOR 0x64
+#define DIV_SDIVIDEND 0x68
+#define DIV_SDIVISOR 0x6c
+#define DIV_QUOTIENT 0x70
+#define DIV_REMAINDER 0x74
+#define DIV_CSR 0x78
+#define DIV_CYCLES 8 // from writing an operand to the results being ready
+
+#define numof(a) (sizeof(a) / sizeof(a[0]))
+
+static const char* fop_names[] = {"",       "idiv",   "i2f",    "f2iz",   "fadd",  "fsub",
+                                  "fmul",   "fdiv",   "fcmple", "fcmpgt", "fcmplt", "fcmpge"};
+
+// approximate cost of the SDK's accelerated helpers, in cycles
+static const int fop_cycles[] = {0, 24, 30, 30, 60, 60, 55, 75, 30, 30, 30, 30};
+
+static uint8_t ram[RAM_BYTES];
+static uint32_t r[16];
+static int fn, fz, fc, fv;
+static uint64_t cycles, instrs, shim_calls;
+static int running, exit_code;
+static int report; // print the counts on stderr when the run ends
+static const char* exe_name;
+
+#define SP r[13]
+#define LR r[14]
+#define PC r[15]
+
+static void report_counts(void) {
+    if (report) {
+        fprintf(stderr, "instructions %llu\ncycles %llu\nshim calls %llu\n",
+                (unsigned long long)instrs, (unsigned long long)cycles,
+                (unsigned long long)shim_calls);
+    }
+}
+
+// the counts up to a fatal error are reported too, the run stopped there
+__attribute__((__noreturn__)) static void sim_fatal(const char* fmt, ...) {
+    va_list ap;
+    fflush(stdout);
+    fprintf(stderr, "%s: ", exe_name);
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fprintf(stderr, " (pc %08x)\n", PC);
+    report_counts();
+    exit(2);
+}
+
+// memory access
+
+static uint8_t* mem(uint32_t a, int sz) {
+    if (a < RAM_BASE || a + sz > RAM_BASE + RAM_BYTES) {
+        sim_fatal("bad memory access at %08x", a);
+    }
+    if (a & (sz - 1)) {
+        sim_fatal("unaligned access at %08x", a);
+    }
+    return ram + (a - RAM_BASE);
+}
+
+// SIO divider state, a division starts when either operand is written
+static struct {
+    uint32_t dividend, divisor, quotient, remainder;
+    uint64_t ready; // cycle count when the results are available
+    int dirty;      // an operand was written and QUOTIENT not read since
+} divider;
+
+static void div_start(int sgn) {
+    int32_t x = divider.dividend, y = divider.divisor;
+    if (!sgn) {
+        divider.quotient = divider.divisor ? divider.dividend / divider.divisor : 0xffffffffu;
+        divider.remainder = divider.divisor ? divider.dividend % divider.divisor : divider.dividend;
+    } else if (y == 0) {
+        divider.quotient = x < 0 ? 1 : -1;
+        divider.remainder = x;
+    } else if (x == INT32_MIN && y == -1) {
+        divider.quotient = x;
+        divider.remainder = 0;
+    } else {
+        divider.quotient = x / y;
+        divider.remainder = x % y;
+    }
+    divider.ready = cycles + DIV_CYCLES;
+    divider.dirty = 1;
+}
+
+static uint32_t sio_rd(uint32_t a) {
+    switch (a - SIO_BASE) {
+    case DIV_UDIVIDEND:
+    case DIV_SDIVIDEND:
+        return divider.dividend;
+    case DIV_UDIVISOR:
+    case DIV_SDIVISOR:
+        return divider.divisor;
+    case DIV_QUOTIENT:
+        if (cycles < divider.ready) {
+            sim_fatal("divider read %d cycles early", (int)(divider.ready - cycles));
+        }
+        divider.dirty = 0;
+        return divider.quotient;
+    case DIV_REMAINDER:
+        if (cycles < divider.ready) {
+            sim_fatal("divider read %d cycles early", (int)(divider.ready - cycles));
+        }
+        return divider.remainder;
+    case DIV_CSR:
+        return (divider.dirty << 1) | (cycles >= divider.ready);
+    }
+    sim_fatal("unsupported SIO register at %08x", a);
+}
+
+static void sio_wr(uint32_t a, uint32_t v) {
+    switch (a - SIO_BASE) {
+    case DIV_UDIVIDEND:
+    case DIV_SDIVIDEND:
+        divider.dividend = v;
+        div_start(a - SIO_BASE == DIV_SDIVIDEND);
+        return;
+    case DIV_UDIVISOR:
+    case DIV_SDIVISOR:
+        divider.divisor = v;
+        div_start(a - SIO_BASE == DIV_SDIVISOR);
+        return;
+    case DIV_QUOTIENT:
+        divider.quotient = v;
+        divider.dirty = 1;
+        return;
+    case DIV_REMAINDER:
+        divider.remainder = v;
+        divider.dirty = 1;
+        return;
+    }
+    sim_fatal("unsupported SIO register at %08x", a);
+}
+
+static uint32_t rd32(uint32_t a) {
+    uint32_t v;
+    if ((a & 0xfffff000u) == SIO_BASE) {
+        return sio_rd(a);
+    }
+    memcpy(&v, mem(a, 4), 4);
+    return v;
+}
+
+static uint16_t rd16(uint32_t a) {
+    uint16_t v;
+    memcpy(&v, mem(a, 2), 2);
+    return v;
+}
+
+static uint8_t rd8(uint32_t a) { return *mem(a, 1); }
+
+static void wr32(uint32_t a, uint32_t v) {
+    if ((a & 0xfffff000u) == SIO_BASE) {
+        sio_wr(a, v);
+        return;
+    }
+    memcpy(mem(a, 4), &v, 4);
+}
+
+static void wr16(uint32_t a, uint16_t v) { memcpy(mem(a, 2), &v, 2); }
+
+static void wr8(uint32_t a, uint8_t v) { *mem(a, 1) = v; }
+
+static char* str(uint32_t a) {
+    char* s = (char*)mem(a, 1);
+    if (!memchr(s, 0, RAM_BASE + RAM_BYTES - a)) {
+        sim_fatal("unterminated string at %08x", a);
+    }
+    return s;
+}
+
+static uint32_t sim_addr(void* p) { return (uint8_t*)p - ram + RAM_BASE; }
+
+static float as_f(uint32_t i) {
+    float f;
+    memcpy(&f, &i, 4);
+    return f;
+}
+
+static uint32_t as_i(float f) {
+    uint32_t i;
+    memcpy(&i, &f, 4);
+    return i;
+}
+
+// user heap, first fit over a list of free blocks
+
+struct blk {
+    uint32_t size; // bytes including header
+    uint32_t next; // next free block (free blocks only)
+};
+
+static uint32_t free_list;
+
+static void heap_init(void) {
+    free_list = HEAP_BASE;
+    wr32(HEAP_BASE, HEAP_BYTES);
+    wr32(HEAP_BASE + 4, 0);
+}
+
+static uint32_t sim_malloc(uint32_t len) {
+    uint32_t need = ((len + 7) & ~7) + 8;
+    uint32_t prev = 0, b = free_list;
+    while (b) {
+        uint32_t sz = rd32(b);
+        if (sz >= need) {
+            uint32_t nxt = rd32(b + 4);
+            if (sz - need >= 16) {
+                wr32(b + need, sz - need);
+                wr32(b + need + 4, nxt);
+                nxt = b + need;
+                sz = need;
+            }
+            if (prev) {
+                wr32(prev + 4, nxt);
+            } else {
+                free_list = nxt;
+            }
+            wr32(b, sz);
+            return b + 8;
+        }
+        prev = b;
+        b = rd32(b + 4);
+    }
+    return 0;
+}
+
+static void sim_free(uint32_t p) {
+    if (p < HEAP_BASE + 8 || p >= HEAP_BASE + HEAP_BYTES) {
+        sim_fatal("freeing a bad pointer %08x", p);
+    }
+    uint32_t b = p - 8;
+    wr32(b + 4, free_list);
+    free_list = b;
+}
+
+// printf and sprintf: arguments are on the stack, last one on top,
+// r0 holds the function's etype (float parameter bits at 10 and up)
+
+static int sim_vformat(char* out, int outsz, uint32_t fmt, uint32_t sp, int etype, int first) {
+    int n_parms = etype & ADJ_MASK;
+    int fbits = etype >> 10;
+    int ix = n_parms - 1 - first;
+    const char* f = str(fmt);
+    int len = 0;
+    char spec[32], tmp[512];
+    while (*f) {
+        if (*f != '%') {
+            if (len < outsz - 1) {
+                out[len] = *f;
+            }
+            ++len;
+            ++f;
+            continue;
+        }
+        const char* s0 = f++;
+        if (*f == '%') {
+            if (len < outsz - 1) {
+                out[len] = '%';
+            }
+            ++len;
+            ++f;
+            continue;
+        }
+        int sl = 0;
+        spec[sl++] = '%';
+        int star[2] = {-1, -1}, nstar = 0;
+        while (*f && strchr("-+ #0123456789.*hlLzjt", *f)) {
+            if (*f == '*') {
+                if (ix < 0) {
+                    sim_fatal("printf: too few arguments");
+                }
+                star[nstar++] = rd32(sp + 4 * ix--);
+            }
+            if (*f != 'h' && *f != 'l' && *f != 'L' && *f != 'z' && *f != 'j' && *f != 't' &&
+                sl < 24) {
+                spec[sl++] = *f;
+            }
+            ++f;
+        }
+        char cv = *f++;
+        if (!cv) {
+            break;
+        }
+        int t;
+        if (ix < 0) {
+            sim_fatal("printf: too few arguments for \"%s\"", s0);
+        }
+        int isf = (fbits >> ix) & 1;
+        uint32_t v = rd32(sp + 4 * ix--);
+        switch (cv) {
+        case 'd':
+        case 'i':
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+        case 'c':
+            spec[sl++] = cv;
+            spec[sl] = 0;
+            if (nstar == 2) {
+                t = snprintf(tmp, sizeof(tmp), spec, star[0], star[1], v);
+            } else if (nstar == 1) {
+                t = snprintf(tmp, sizeof(tmp), spec, star[0], v);
+            } else {
+                t = snprintf(tmp, sizeof(tmp), spec, v);
+            }
+            break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A': {
+            double d = isf ? as_f(v) : (double)(int)v;
+            spec[sl++] = cv;
+            spec[sl] = 0;
+            if (nstar == 2) {
+                t = snprintf(tmp, sizeof(tmp), spec, star[0], star[1], d);
+            } else if (nstar == 1) {
+                t = snprintf(tmp, sizeof(tmp), spec, star[0], d);
+            } else {
+                t = snprintf(tmp, sizeof(tmp), spec, d);
+            }
+            break;
+        }
+        case 's': {
+            const char* sv = v ? str(v) : "(null)";
+            spec[sl++] = 's';
+            spec[sl] = 0;
+            if (nstar == 2) {
+                t = snprintf(tmp, sizeof(tmp), spec, star[0], star[1], sv);
+            } else if (nstar == 1) {
+                t = snprintf(tmp, sizeof(tmp), spec, star[0], sv);
+            } else {
+                t = snprintf(tmp, sizeof(tmp), spec, sv);
+            }
+            break;
+        }
+        case 'p':
+            t = snprintf(tmp, sizeof(tmp), "0x%x", v);
+            break;
+        default:
+            sim_fatal("printf: unsupported conversion %%%c", cv);
+        }
+        if (t > (int)sizeof(tmp) - 1) {
+            t = sizeof(tmp) - 1;
+        }
+        for (int i = 0; i < t; i++, len++) {
+            if (len < outsz - 1) {
+                out[len] = tmp[i];
+            }
+        }
+    }
+    if (outsz) {
+        out[len < outsz ? len : outsz - 1] = 0;
+    }
+    return len;
+}
+
+// arguments of a called extern, first four in registers, rest on the stack
+static uint32_t arg(int i) { return i < 4 ? r[i] : rd32(SP + 4 * (i - 4)); }
+
+static float farg(int i) { return as_f(arg(i)); }
+
+static uint64_t time_us(void) { return cycles / 133; }
+
+static void call_extern(int ix) {
+    const char* nm = sim_externs[ix].name;
+    char buf[4096];
+    uint32_t rv = 0;
+    ++shim_calls;
+    cycles += 10;
+    if (!strcmp(nm, "printf")) {
+        int l = sim_vformat(buf, sizeof(buf), rd32(SP + 4 * ((r[0] & ADJ_MASK) - 1)), SP, r[0], 1);
+        fwrite(buf, 1, l < (int)sizeof(buf) ? l : (int)sizeof(buf) - 1, stdout);
+        cycles += 40 * l;
+        rv = l;
+    } else if (!strcmp(nm, "sprintf")) {
+        int np = r[0] & ADJ_MASK;
+        uint32_t dst = rd32(SP + 4 * (np - 1));
+        int l = sim_vformat(buf, sizeof(buf), rd32(SP + 4 * (np - 2)), SP, r[0], 2);
+        memcpy(mem(dst, 1), buf, l + 1);
+        str(dst);
+        cycles += 40 * l;
+        rv = l;
+    } else if (!strcmp(nm, "exit")) {
+        running = 0;
+        exit_code = r[0];
+        return;
+    } else if (!strcmp(nm, "malloc")) {
+        rv = sim_malloc(r[0]);
+    } else if (!strcmp(nm, "calloc")) {
+        rv = sim_malloc(r[0] * r[1]);
+        if (rv) {
+            memset(mem(rv, 1), 0, r[0] * r[1]);
+        }
+    } else if (!strcmp(nm, "free")) {
+        sim_free(r[0]);
+    } else if (!strcmp(nm, "strlen")) {
+        rv = strlen(str(r[0]));
+    } else if (!strcmp(nm, "strcpy")) {
+        strcpy((char*)mem(r[0], 1), str(r[1]));
+        rv = r[0];
+    } else if (!strcmp(nm, "strncpy")) {
+        strncpy((char*)mem(r[0], 1), (char*)mem(r[1], 1), r[2]);
+        rv = r[0];
+    } else if (!strcmp(nm, "strcat")) {
+        strcat(str(r[0]), str(r[1]));
+        rv = r[0];
+    } else if (!strcmp(nm, "strncat")) {
+        strncat(str(r[0]), (char*)mem(r[1], 1), r[2]);
+        rv = r[0];
+    } else if (!strcmp(nm, "strcmp")) {
+        rv = strcmp(str(r[0]), str(r[1]));
+    } else if (!strcmp(nm, "strncmp")) {
+        rv = strncmp((char*)mem(r[0], 1), (char*)mem(r[1], 1), r[2]);
+    } else if (!strcmp(nm, "strchr")) {
+        char* s = strchr(str(r[0]), (char)r[1]);
+        rv = s ? sim_addr(s) : 0;
+    } else if (!strcmp(nm, "strrchr")) {
+        char* s = strrchr(str(r[0]), (char)r[1]);
+        rv = s ? sim_addr(s) : 0;
+    } else if (!strcmp(nm, "strdup")) {
+        int l = strlen(str(r[0]));
+        rv = sim_malloc(l + 1);
+        if (rv) {
+            memcpy(mem(rv, 1), str(r[0]), l + 1);
+        }
+    } else if (!strcmp(nm, "strtol")) {
+        char* end;
+        rv = strtol(str(r[0]), &end, r[2]);
+        if (r[1]) {
+            wr32(r[1], sim_addr(end));
+        }
+    } else if (!strcmp(nm, "atoi")) {
+        rv = atoi(str(r[0]));
+    } else if (!strcmp(nm, "memset")) {
+        if (r[2]) {
+            memset(mem(r[0], 1), r[1], r[2]);
+            mem(r[0] + r[2] - 1, 1);
+        }
+        rv = r[0];
+        cycles += r[2] / 4;
+    } else if (!strcmp(nm, "memcpy")) {
+        if (r[2]) {
+            mem(r[0] + r[2] - 1, 1);
+            mem(r[1] + r[2] - 1, 1);
+            memmove(mem(r[0], 1), mem(r[1], 1), r[2]);
+        }
+        rv = r[0];
+        cycles += r[2] / 2;
+    } else if (!strcmp(nm, "memcmp")) {
+        rv = r[2] ? memcmp(mem(r[0], 1), mem(r[1], 1), r[2]) : 0;
+    } else if (!strcmp(nm, "putchar")) {
+        putchar(r[0]);
+        rv = r[0] & 0xff;
+    } else if (!strcmp(nm, "getchar")) {
+        rv = getchar();
+    } else if (!strcmp(nm, "getchar_timeout_us")) {
+        rv = -1;
+    } else if (!strcmp(nm, "rand")) {
+        rv = rand() & 0x7fffffff;
+    } else if (!strcmp(nm, "srand")) {
+        srand(r[0]);
+    } else if (!strcmp(nm, "get_rand_32")) {
+        rv = ((uint32_t)rand() << 16) ^ rand();
+    } else if (!strcmp(nm, "popcount")) {
+        rv = __builtin_popcount(r[0]);
+    } else if (!strcmp(nm, "time_us_32")) {
+        rv = time_us();
+    } else if (!strcmp(nm, "sleep_ms")) {
+        cycles += (uint64_t)r[0] * 133000;
+    } else if (!strcmp(nm, "sleep_us")) {
+        cycles += (uint64_t)r[0] * 133;
+    } else if (!strcmp(nm, "screen_width")) {
+        rv = 80;
+    } else if (!strcmp(nm, "screen_height")) {
+        rv = 24;
+    } else if (!strcmp(nm, "wfi")) {
+    } else if (!strcmp(nm, "sqrtf")) {
+        rv = as_i(sqrtf(farg(0)));
+    } else if (!strcmp(nm, "sinf")) {
+        rv = as_i(sinf(farg(0)));
+    } else if (!strcmp(nm, "cosf")) {
+        rv = as_i(cosf(farg(0)));
+    } else if (!strcmp(nm, "tanf")) {
+        rv = as_i(tanf(farg(0)));
+    } else if (!strcmp(nm, "asinf")) {
+        rv = as_i(asinf(farg(0)));
+    } else if (!strcmp(nm, "acosf")) {
+        rv = as_i(acosf(farg(0)));
+    } else if (!strcmp(nm, "atanf")) {
+        rv = as_i(atanf(farg(0)));
+    } else if (!strcmp(nm, "sinhf")) {
+        rv = as_i(sinhf(farg(0)));
+    } else if (!strcmp(nm, "coshf")) {
+        rv = as_i(coshf(farg(0)));
+    } else if (!strcmp(nm, "tanhf")) {
+        rv = as_i(tanhf(farg(0)));
+    } else if (!strcmp(nm, "asinhf")) {
+        rv = as_i(asinhf(farg(0)));
+    } else if (!strcmp(nm, "acoshf")) {
+        rv = as_i(acoshf(farg(0)));
+    } else if (!strcmp(nm, "atanhf")) {
+        rv = as_i(atanhf(farg(0)));
+    } else if (!strcmp(nm, "logf")) {
+        rv = as_i(logf(farg(0)));
+    } else if (!strcmp(nm, "log10f")) {
+        rv = as_i(log10f(farg(0)));
+    } else if (!strcmp(nm, "powf")) {
+        rv = as_i(powf(farg(0), farg(1)));
+    } else if (!strcmp(nm, "atan2f")) {
+        rv = as_i(atan2f(farg(0), farg(1)));
+    } else if (!strcmp(nm, "fmodf")) {
+        rv = as_i(fmodf(farg(0), farg(1)));
+    } else {
+        sim_fatal("unsupported external function %s", nm);
+    }
+    r[0] = rv;
+}
+
+static void call_fop(int n) {
+    float a = as_f(r[0]), b = as_f(r[1]);
+    ++shim_calls;
+    cycles += fop_cycles[n];
+    switch (n) {
+    case 1: { // idiv, quotient in r0 and remainder in r1
+        int32_t x = r[0], y = r[1];
+        if (y == 0) {
+            r[0] = x < 0 ? 1 : -1;
+            r[1] = x;
+        } else if (x == INT32_MIN && y == -1) {
+            r[0] = x;
+            r[1] = 0;
+        } else {
+            r[0] = x / y;
+            r[1] = x % y;
+        }
+        break;
+    }
+    case 2:
+        r[0] = as_i((float)(int32_t)r[0]);
+        break;
+    case 3:
+        if (isnan(a)) {
+            r[0] = 0;
+        } else if (a >= 2147483648.0f) {
+            r[0] = INT32_MAX;
+        } else if (a < -2147483648.0f) {
+            r[0] = INT32_MIN;
+        } else {
+            r[0] = (int32_t)a;
+        }
+        break;
+    case 4:
+        r[0] = as_i(a + b);
+        break;
+    case 5:
+        r[0] = as_i(a - b);
+        break;
+    case 6:
+        r[0] = as_i(a * b);
+        break;
+    case 7:
+        r[0] = as_i(a / b);
+        break;
+    case 8:
+        r[0] = a <= b;
+        break;
+    case 9:
+        r[0] = a > b;
+        break;
+    case 10:
+        r[0] = a < b;
+        break;
+    case 11:
+        r[0] = a >= b;
+        break;
+    default:
+        sim_fatal("bad helper function %d", n);
+    }
+}
+
+// branch to an address, possibly a host shim
+static void branch(uint32_t to) {
+    if (to >= NEAR_EXTERN_BASE && to < NEAR_END) {
+        to = (to < NEAR_FOP_BASE) ? EXTERN_BASE + (to - NEAR_EXTERN_BASE)
+                                  : FOP_BASE + (to - NEAR_FOP_BASE);
+    }
+    if (to >= EXTERN_BASE) {
+        if (to == (EXIT_ADDR | 1)) {
+            running = 0;
+            exit_code = r[0];
+            return;
+        }
+        if (to >= FOP_BASE) {
+            call_fop((to - FOP_BASE) >> 1);
+        } else {
+            call_extern((to - EXTERN_BASE) >> 1);
+        }
+        if (running) {
+            branch(LR);
+        }
+        return;
+    }
+    if (!(to & 1)) {
+        sim_fatal("branch to ARM state address %08x", to);
+    }
+    PC = to & ~1;
+}
+
+// flags
+
+static void set_nz(uint32_t v) {
+    fn = v >> 31;
+    fz = v == 0;
+}
+
+static uint32_t add_flags(uint32_t a, uint32_t b, int carry) {
+    uint64_t u = (uint64_t)a + b + carry;
+    int64_t s = (int64_t)(int32_t)a + (int32_t)b + carry;
+    uint32_t v = (uint32_t)u;
+    set_nz(v);
+    fc = u >> 32;
+    fv = s != (int32_t)v;
+    return v;
+}
+
+static int cond_pass(int c) {
+    switch (c) {
+    case 0:
+        return fz;
+    case 1:
+        return !fz;
+    case 2:
+        return fc;
+    case 3:
+        return !fc;
+    case 4:
+        return fn;
+    case 5:
+        return !fn;
+    case 6:
+        return fv;
+    case 7:
+        return !fv;
+    case 8:
+        return fc && !fz;
+    case 9:
+        return !fc || fz;
+    case 10:
+        return fn == fv;
+    case 11:
+        return fn != fv;
+    case 12:
+        return !fz && fn == fv;
+    case 13:
+        return fz || fn != fv;
+    default:
+        return 1;
+    }
+}
+
+static uint32_t shift(int op, uint32_t v, int n, int set_c) {
+    // op 0 lsl, 1 lsr, 2 asr, 3 ror; register specified amounts
+    n &= 0xff;
+    if (n == 0) {
+        return v;
+    }
+    switch (op) {
+    case 0:
+        if (set_c) {
+            fc = n <= 32 ? (n == 32 ? v & 1 : (v >> (32 - n)) & 1) : 0;
+        }
+        return n >= 32 ? 0 : v << n;
+    case 1:
+        if (set_c) {
+            fc = n <= 32 ? (v >> (n - 1)) & 1 : 0;
+        }
+        return n >= 32 ? 0 : v >> n;
+    case 2:
+        if (n >= 32) {
+            if (set_c) {
+                fc = v >> 31;
+            }
+            return (int32_t)v >> 31;
+        }
+        if (set_c) {
+            fc = (v >> (n - 1)) & 1;
+        }
+        return (int32_t)v >> n;
+    default:
+        n &= 31;
+        if (n == 0) {
+            if (set_c) {
+                fc = v >> 31;
+            }
+            return v;
+        }
+        v = (v >> n) | (v << (32 - n));
+        if (set_c) {
+            fc = v >> 31;
+        }
+        return v;
+    }
+}
+
+static void step(void) {
+    uint32_t pc = PC;
+    uint16_t op = rd16(pc);
+    uint32_t pcv = pc + 4; // value of pc as an operand
+    PC = pc + 2;
+    ++instrs;
+    ++cycles;
+    int rd = op & 7, rn = (op >> 3) & 7, rm = (op >> 6) & 7;
+    uint32_t a, b, v;
+    switch (op >> 11) {
+    case 0: // lsls imm
+    case 1: // lsrs imm
+    case 2: // asrs imm
+    {
+        int imm = (op >> 6) & 31;
+        int sh = op >> 11;
+        v = r[rn];
+        if (imm == 0 && sh != 0) {
+            imm = 32;
+        }
+        if (imm) {
+            v = shift(sh, v, imm, 1);
+        }
+        r[rd] = v;
+        set_nz(v);
+        return;
+    }
+    case 3:
+        a = r[rn];
+        b = (op & 0x400) ? (uint32_t)rm : r[rm];
+        if (op & 0x200) {
+            r[rd] = add_flags(a, ~b, 1); // subs
+        } else {
+            r[rd] = add_flags(a, b, 0); // adds
+        }
+        return;
+    case 4: // movs imm8
+        rd = (op >> 8) & 7;
+        r[rd] = op & 0xff;
+        set_nz(r[rd]);
+        return;
+    case 5: // cmp imm8
+        add_flags(r[(op >> 8) & 7], ~(uint32_t)(op & 0xff), 1);
+        return;
+    case 6: // adds imm8
+        rd = (op >> 8) & 7;
+        r[rd] = add_flags(r[rd], op & 0xff, 0);
+        return;
+    case 7: // subs imm8
+        rd = (op >> 8) & 7;
+        r[rd] = add_flags(r[rd], ~(uint32_t)(op & 0xff), 1);
+        return;
+    case 8:
+        if ((op & 0xfc00) == 0x4000) { // data processing
+            a = r[rd];
+            b = r[rn];
+            switch ((op >> 6) & 15) {
+            case 0: // ands
+                r[rd] = a & b;
+                set_nz(r[rd]);
+                break;
+            case 1: // eors
+                r[rd] = a ^ b;
+                set_nz(r[rd]);
+                break;
+            case 2: // lsls
+                r[rd] = shift(0, a, b, 1);
+                set_nz(r[rd]);
+                break;
+            case 3: // lsrs
+                r[rd] = shift(1, a, b, 1);
+                set_nz(r[rd]);
+                break;
+            case 4: // asrs
+                r[rd] = shift(2, a, b, 1);
+                set_nz(r[rd]);
+                break;
+            case 5: // adcs
+                r[rd] = add_flags(a, b, fc);
+                break;
+            case 6: // sbcs
+                r[rd] = add_flags(a, ~b, fc);
+                break;
+            case 7: // rors
+                r[rd] = shift(3, a, b, 1);
+                set_nz(r[rd]);
+                break;
+            case 8: // tst
+                set_nz(a & b);
+                break;
+            case 9: // rsbs
+                r[rd] = add_flags(~b, 0, 1);
+                break;
+            case 10: // cmp
+                add_flags(a, ~b, 1);
+                break;
+            case 11: // cmn
+                add_flags(a, b, 0);
+                break;
+            case 12: // orrs
+                r[rd] = a | b;
+                set_nz(r[rd]);
+                break;
+            case 13: // muls
+                r[rd] = a * b;
+                set_nz(r[rd]);
+                break;
+            case 14: // bics
+                r[rd] = a & ~b;
+                set_nz(r[rd]);
+                break;
+            case 15: // mvns
+                r[rd] = ~b;
+                set_nz(r[rd]);
+                break;
+            }
+            return;
+        }
+        if ((op & 0xfc00) == 0x4400) { // special data, branch exchange
+            int rdh = (op & 7) | ((op >> 4) & 8);
+            int rmh = (op >> 3) & 15;
+            uint32_t mv = rmh == 15 ? pcv : r[rmh];
+            switch ((op >> 8) & 3) {
+            case 0: // add
+                if (rdh == 15) {
+                    PC = (pcv + mv) & ~1;
+                    ++cycles;
+                } else {
+                    r[rdh] += mv;
+                }
+                return;
+            case 1: // cmp
+                add_flags(rdh == 15 ? pcv : r[rdh], ~mv, 1);
+                return;
+            case 2: // mov
+                if (rdh == 15) {
+                    PC = mv & ~1;
+                    ++cycles;
+                } else {
+                    r[rdh] = mv;
+                }
+                return;
+            case 3: // bx / blx
+                ++cycles;
+                if (op & 0x80) {
+                    LR = (pc + 2) | 1;
+                }
+                branch(mv);
+                return;
+            }
+        }
+        break;
+    case 9: // ldr rd,[pc,#imm]
+        rd = (op >> 8) & 7;
+        r[rd] = rd32((pcv & ~3) + (op & 0xff) * 4);
+        ++cycles;
+        return;
+    case 10:
+    case 11: // load/store register offset
+        a = r[rn] + r[rm];
+        ++cycles;
+        switch ((op >> 9) & 7) {
+        case 0:
+            wr32(a, r[rd]);
+            break;
+        case 1:
+            wr16(a, r[rd]);
+            break;
+        case 2:
+            wr8(a, r[rd]);
+            break;
+        case 3:
+            r[rd] = (int8_t)rd8(a);
+            break;
+        case 4:
+            r[rd] = rd32(a);
+            break;
+        case 5:
+            r[rd] = rd16(a);
+            break;
+        case 6:
+            r[rd] = rd8(a);
+            break;
+        case 7:
+            r[rd] = (int16_t)rd16(a);
+            break;
+        }
+        return;
+    case 12: // str imm
+        wr32(r[rn] + ((op >> 6) & 31) * 4, r[rd]);
+        ++cycles;
+        return;
+    case 13: // ldr imm
+        r[rd] = rd32(r[rn] + ((op >> 6) & 31) * 4);
+        ++cycles;
+        return;
+    case 14: // strb imm
+        wr8(r[rn] + ((op >> 6) & 31), r[rd]);
+        ++cycles;
+        return;
+    case 15: // ldrb imm
+        r[rd] = rd8(r[rn] + ((op >> 6) & 31));
+        ++cycles;
+        return;
+    case 16: // strh imm
+        wr16(r[rn] + ((op >> 6) & 31) * 2, r[rd]);
+        ++cycles;
+        return;
+    case 17: // ldrh imm
+        r[rd] = rd16(r[rn] + ((op >> 6) & 31) * 2);
+        ++cycles;
+        return;
+    case 18: // str rd,[sp,#imm]
+        wr32(SP + (op & 0xff) * 4, r[(op >> 8) & 7]);
+        ++cycles;
+        return;
+    case 19: // ldr rd,[sp,#imm]
+        r[(op >> 8) & 7] = rd32(SP + (op & 0xff) * 4);
+        ++cycles;
+        return;
+    case 20: // adr
+        r[(op >> 8) & 7] = (pcv & ~3) + (op & 0xff) * 4;
+        return;
+    case 21: // add rd,sp,#imm
+        r[(op >> 8) & 7] = SP + (op & 0xff) * 4;
+        return;
+    case 22:
+    case 23: // miscellaneous
+        if ((op & 0xff00) == 0xb000) {
+            if (op & 0x80) {
+                SP -= (op & 0x7f) * 4;
+            } else {
+                SP += (op & 0x7f) * 4;
+            }
+            return;
+        }
+        if ((op & 0xfe00) == 0xb400) { // push
+            int cnt = __builtin_popcount(op & 0x1ff);
+            a = SP - 4 * cnt;
+            SP = a;
+            for (int i = 0; i < 8; i++) {
+                if (op & (1 << i)) {
+                    wr32(a, r[i]);
+                    a += 4;
+                }
+            }
+            if (op & 0x100) {
+                wr32(a, LR);
+            }
+            cycles += cnt;
+            return;
+        }
+        if ((op & 0xfe00) == 0xbc00) { // pop
+            int cnt = __builtin_popcount(op & 0x1ff);
+            a = SP;
+            SP += 4 * cnt;
+            for (int i = 0; i < 8; i++) {
+                if (op & (1 << i)) {
+                    r[i] = rd32(a);
+                    a += 4;
+                }
+            }
+            cycles += cnt;
+            if (op & 0x100) {
+                cycles += 2;
+                branch(rd32(a));
+            }
+            return;
+        }
+        switch (op & 0xffc0) {
+        case 0xb200: // sxth
+            r[rd] = (int16_t)r[rn];
+            return;
+        case 0xb240: // sxtb
+            r[rd] = (int8_t)r[rn];
+            return;
+        case 0xb280: // uxth
+            r[rd] = (uint16_t)r[rn];
+            return;
+        case 0xb2c0: // uxtb
+            r[rd] = (uint8_t)r[rn];
+            return;
+        case 0xba00: // rev
+            r[rd] = __builtin_bswap32(r[rn]);
+            return;
+        case 0xba40: // rev16
+            v = r[rn];
+            r[rd] = ((v & 0xff00ff00) >> 8) | ((v & 0x00ff00ff) << 8);
+            return;
+        case 0xbac0: // revsh
+            r[rd] = (int16_t)(((r[rn] & 0xff) << 8) | ((r[rn] >> 8) & 0xff));
+            return;
+        }
+        if ((op & 0xff00) == 0xbf00 || (op & 0xffe8) == 0xb660) { // hints, cps
+            return;
+        }
+        if ((op & 0xff00) == 0xbe00) {
+            sim_fatal("breakpoint");
+        }
+        break;
+    case 24: // stmia
+    case 25: // ldmia
+    {
+        int rb = (op >> 8) & 7;
+        a = r[rb];
+        int cnt = __builtin_popcount(op & 0xff);
+        cycles += cnt;
+        for (int i = 0; i < 8; i++) {
+            if (op & (1 << i)) {
+                if (op & 0x800) {
+                    r[i] = rd32(a);
+                } else {
+                    wr32(a, r[i]);
+                }
+                a += 4;
+            }
+        }
+        if (!(op & 0x800) || !(op & (1 << rb))) {
+            r[rb] = a;
+        }
+        return;
+    }
+    case 26:
+    case 27: // conditional branch, svc
+    {
+        int c = (op >> 8) & 15;
+        if (c == 15) {
+            sim_fatal("svc not supported");
+        }
+        if (c == 14) {
+            break;
+        }
+        if (cond_pass(c)) {
+            PC = pcv + ((int8_t)(op & 0xff)) * 2;
+            ++cycles;
+        }
+        return;
+    }
+    case 28: // b
+        PC = pcv + (((int32_t)(op << 21)) >> 20);
+        ++cycles;
+        return;
+    case 30: { // 32 bit instructions
+        uint16_t op2 = rd16(pc + 2);
+        PC = pc + 4;
+        if ((op2 & 0xd000) == 0xd000) { // bl
+            int s = (op >> 10) & 1;
+            int j1 = (op2 >> 13) & 1, j2 = (op2 >> 11) & 1;
+            int i1 = !(j1 ^ s), i2 = !(j2 ^ s);
+            int32_t ofs = (s ? 0xff000000 : 0) | (i1 << 23) | (i2 << 22) | ((op & 0x3ff) << 12) |
+                          ((op2 & 0x7ff) << 1);
+            LR = (pc + 4) | 1;
+            cycles += 2;
+            branch((pc + 4 + ofs) | 1);
+            return;
+        }
+        if ((op & 0xffe0) == 0xf3e0 || (op & 0xffe0) == 0xf380 || op == 0xf3bf) {
+            cycles += 3; // mrs, msr, barriers
+            return;
+        }
+        break;
+    }
+    }
+    PC = pc;
+    sim_fatal("undefined instruction %04x", op);
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: ccsim [-c] [-l max_instructions] file.exe [args]\n"
+                    "  -c  report instruction and cycle counts on stderr\n");
+    exit(2);
+}
+
+int main(int argc, char** argv) {
+    uint64_t limit = 2000000000ull;
+    int ai = 1;
+    while (ai < argc && argv[ai][0] == '-') {
+        if (!strcmp(argv[ai], "-c")) {
+            report = 1;
+        } else if (!strcmp(argv[ai], "-l") && ai + 1 < argc) {
+            limit = strtoull(argv[++ai], 0, 0);
+        } else {
+            usage();
+        }
+        ++ai;
+    }
+    if (ai >= argc) {
+        usage();
+    }
+    exe_name = argv[ai];
+    FILE* fp = fopen(exe_name, "rb");
+    if (!fp) {
+        perror(exe_name);
+        return 2;
+    }
+    struct exe_s exe;
+    if (fread(&exe, sizeof(exe), 1, fp) != 1) {
+        sim_fatal("error reading header");
+    }
+    if ((exe.dsize & 0xc0000000) != 0xc0000000) {
+        sim_fatal("not a pshell executable");
+    }
+    int ds = exe.dsize & 0x3fffffff;
+    if (exe.tsize > TEXT_BYTES || ds > DATA_BYTES) {
+        sim_fatal("bad segment sizes");
+    }
+    if (fread(ram + (TEXT_BASE - RAM_BASE), 1, exe.tsize, fp) != (size_t)exe.tsize ||
+        fread(ram + (DATA_BASE - RAM_BASE), 1, ds, fp) != (size_t)ds) {
+        sim_fatal("error reading segments");
+    }
+    for (int i = 0; i < exe.nreloc; i++) {
+        uint32_t addr;
+        if (fread(&addr, sizeof(addr), 1, fp) != 1) {
+            sim_fatal("error reading relocations");
+        }
+        if (addr & 1) { // bl holding the function index
+            addr &= ~1u;
+            int32_t v = (int32_t)(rd16(addr) | ((uint32_t)rd16(addr + 2) << 16));
+            uint32_t to;
+            if (v < 0) {
+                if (-v >= (int)numof(fop_names)) {
+                    sim_fatal("bad relocation at %08x", addr);
+                }
+                to = NEAR_FOP_BASE + (-v << 1);
+            } else {
+                if (v >= (int)numof(sim_externs)) {
+                    sim_fatal("bad relocation at %08x", addr);
+                }
+                to = NEAR_EXTERN_BASE + (v << 1);
+            }
+            int32_t ofs = (int32_t)(to - (addr + 4)) >> 1;
+            int sb = (ofs >> 31) & 1;
+            int j1 = sb ^ (((ofs >> 22) & 1) ^ 1);
+            int j2 = sb ^ (((ofs >> 21) & 1) ^ 1);
+            wr16(addr, 0xf000 | (sb << 10) | ((ofs >> 11) & 0x3ff));
+            wr16(addr + 2, 0xd000 | (j1 << 13) | (j2 << 11) | (ofs & 0x7ff));
+            continue;
+        }
+        int32_t v = rd32(addr);
+        if (v < 0) {
+            if (-v >= (int)numof(fop_names)) {
+                sim_fatal("bad relocation at %08x", addr);
+            }
+            wr32(addr, (FOP_BASE + (-v << 1)) | 1);
+        } else {
+            if (v >= (int)numof(sim_externs)) {
+                sim_fatal("bad relocation at %08x", addr);
+            }
+            wr32(addr, (EXTERN_BASE + (v << 1)) | 1);
+        }
+    }
+    fclose(fp);
+
+    heap_init();
+    // program arguments, argv[0] is the exe name as on the pico
+    int pargc = argc - ai;
+    uint32_t pargv = sim_malloc(4 * (pargc + 1));
+    for (int i = 0; i < pargc; i++) {
+        int l = strlen(argv[ai + i]);
+        uint32_t s = sim_malloc(l + 1);
+        memcpy(mem(s, 1), argv[ai + i], l + 1);
+        wr32(pargv + 4 * i, s);
+    }
+    wr32(pargv + 4 * pargc, 0);
+
+    // same entry sequence as the pico loader: argc and argv in r0 and r1 and
+    // pushed on the stack, blx main
+    r[0] = pargc;
+    r[1] = pargv;
+    SP = STACK_TOP;
+    SP -= 4;
+    wr32(SP, pargc);
+    SP -= 4;
+    wr32(SP, pargv);
+    LR = EXIT_ADDR | 1;
+    PC = exe.entry & ~1;
+    running = 1;
+    while (running) {
+        step();
+        if (instrs >= limit) {
+            sim_fatal("instruction limit exceeded");
+        }
+        if (SP < STACK_LIMIT) {
+            sim_fatal("stack overflow");
+        }
+    }
+    fflush(stdout);
+    report_counts();
+    if (report) {
+        fprintf(stderr, "exit %d\n", exit_code);
+    }
+    return exit_code & 0xff;
+}
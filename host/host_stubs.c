@@ -0,0 +1,29 @@
+// Host stand-ins for the functions the externs table takes the address of.
+// The compiler and the simulator only use their position in the table.
+
+#include "pico_host.h"
+#include "cc_wraps.h"
+
+#define HOST_EXTERN(f) \
+    void f() {}
+#include "host_externs.h"
+#undef HOST_EXTERN
+
+void* wrap_malloc(int len) { return 0; }
+void* wrap_calloc(int nmemb, int siz) { return 0; }
+int wrap_open(char* name, int mode) { return 0; }
+int wrap_opendir(char* name) { return 0; }
+void wrap_close(int handle) {}
+int wrap_read(int handle, void* buf, int len) { return 0; }
+int wrap_readdir(int handle, void* buf) { return 0; }
+int wrap_write(int handle, void* buf, int len) { return 0; }
+int wrap_lseek(int handle, int pos, int set) { return 0; }
+int wrap_popcount(int n) { return 0; }
+int wrap_remove(char* name) { return 0; }
+int wrap_rename(char* old, char* new) { return 0; }
+int wrap_screen_height(void) { return 0; }
+int wrap_screen_width(void) { return 0; }
+void wrap_wfi(void) {}
+char* x_strdup(char* s) { return 0; }
+int x_printf(int etype) { return 0; }
+int x_sprintf(int etype) { return 0; }
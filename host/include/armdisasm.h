@@ -0,0 +1,19 @@
+// Host stand-in for the ARM disassembler; -s is not supported on the host.
+#ifndef _ARMDISASM_HOST_H_
+#define _ARMDISASM_HOST_H_
+#include <stdint.h>
+typedef struct {
+    uint32_t address;
+    int size;
+    char text[128];
+} ARMSTATE;
+#define DISASM_ADDRESS 1
+#define DISASM_INSTR 2
+#define DISASM_COMMENT 4
+#define ARMMODE_THUMB 1
+#define disasm_init(s, f) ((void)0)
+#define disasm_cleanup(s) ((void)0)
+#define disasm_symbol(s, n, a, m) ((void)0)
+#define disasm_address(s, a) ((s)->address = (a), (s)->size = 0)
+#define disasm_thumb(s, a, b) ((s)->address += (s)->size, (s)->size = 2, (s)->text[0] = 0)
+#endif
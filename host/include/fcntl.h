@@ -0,0 +1,11 @@
+// newlib open() flag values, as seen by programs running on the pico
+#ifndef _HOST_FCNTL_H_
+#define _HOST_FCNTL_H_
+#define O_RDONLY 0
+#define O_WRONLY 1
+#define O_RDWR 2
+#define O_APPEND 0x0008
+#define O_CREAT 0x0200
+#define O_TRUNC 0x0400
+#define O_EXCL 0x0800
+#endif
@@ -0,0 +1,193 @@
+// Every SDK and pshell function named in cc_extrns.h, declared by pico_host.h
+// and defined as an empty stub by cc_host.c
+HOST_EXTERN(__wrap_acosf)
+HOST_EXTERN(__wrap_acoshf)
+HOST_EXTERN(__wrap_asinf)
+HOST_EXTERN(__wrap_asinhf)
+HOST_EXTERN(__wrap_atanf)
+HOST_EXTERN(__wrap_atanhf)
+HOST_EXTERN(__wrap_cosf)
+HOST_EXTERN(__wrap_coshf)
+HOST_EXTERN(__wrap_sinf)
+HOST_EXTERN(__wrap_sinhf)
+HOST_EXTERN(__wrap_tanf)
+HOST_EXTERN(__wrap_tanhf)
+HOST_EXTERN(adc_fifo_drain)
+HOST_EXTERN(adc_fifo_get)
+HOST_EXTERN(adc_fifo_get_blocking)
+HOST_EXTERN(adc_fifo_get_level)
+HOST_EXTERN(adc_fifo_is_empty)
+HOST_EXTERN(adc_fifo_setup)
+HOST_EXTERN(adc_get_selected_input)
+HOST_EXTERN(adc_gpio_init)
+HOST_EXTERN(adc_init)
+HOST_EXTERN(adc_irq_set_enabled)
+HOST_EXTERN(adc_read)
+HOST_EXTERN(adc_run)
+HOST_EXTERN(adc_select_input)
+HOST_EXTERN(adc_set_clkdiv)
+HOST_EXTERN(adc_set_round_robin)
+HOST_EXTERN(adc_set_temp_sensor_enabled)
+HOST_EXTERN(cc_exit)
+HOST_EXTERN(clock_configure)
+HOST_EXTERN(clock_configure_gpin)
+HOST_EXTERN(clock_get_hz)
+HOST_EXTERN(clock_gpio_init)
+HOST_EXTERN(clock_set_reported_hz)
+HOST_EXTERN(clock_stop)
+HOST_EXTERN(clocks_enable_resus)
+HOST_EXTERN(clocks_init)
+HOST_EXTERN(frequency_count_khz)
+HOST_EXTERN(frequency_count_mhz)
+HOST_EXTERN(get_rand_32)
+HOST_EXTERN(getchar_timeout_us)
+HOST_EXTERN(gpio_acknowledge_irq)
+HOST_EXTERN(gpio_add_raw_irq_handler)
+HOST_EXTERN(gpio_add_raw_irq_handler_masked)
+HOST_EXTERN(gpio_add_raw_irq_handler_with_order_priority)
+HOST_EXTERN(gpio_add_raw_irq_handler_with_order_priority_masked)
+HOST_EXTERN(gpio_clr_mask)
+HOST_EXTERN(gpio_deinit)
+HOST_EXTERN(gpio_disable_pulls)
+HOST_EXTERN(gpio_get)
+HOST_EXTERN(gpio_get_all)
+HOST_EXTERN(gpio_get_dir)
+HOST_EXTERN(gpio_get_drive_strength)
+HOST_EXTERN(gpio_get_function)
+HOST_EXTERN(gpio_get_irq_event_mask)
+HOST_EXTERN(gpio_get_out_level)
+HOST_EXTERN(gpio_get_slew_rate)
+HOST_EXTERN(gpio_init)
+HOST_EXTERN(gpio_init_mask)
+HOST_EXTERN(gpio_is_dir_out)
+HOST_EXTERN(gpio_is_input_hysteresis_enabled)
+HOST_EXTERN(gpio_is_pulled_down)
+HOST_EXTERN(gpio_is_pulled_up)
+HOST_EXTERN(gpio_pull_down)
+HOST_EXTERN(gpio_pull_up)
+HOST_EXTERN(gpio_put)
+HOST_EXTERN(gpio_put_all)
+HOST_EXTERN(gpio_put_masked)
+HOST_EXTERN(gpio_remove_raw_irq_handler)
+HOST_EXTERN(gpio_remove_raw_irq_handler_masked)
+HOST_EXTERN(gpio_set_dir)
+HOST_EXTERN(gpio_set_dir_all_bits)
+HOST_EXTERN(gpio_set_dir_in_masked)
+HOST_EXTERN(gpio_set_dir_masked)
+HOST_EXTERN(gpio_set_dir_out_masked)
+HOST_EXTERN(gpio_set_dormant_irq_enabled)
+HOST_EXTERN(gpio_set_drive_strength)
+HOST_EXTERN(gpio_set_function)
+HOST_EXTERN(gpio_set_inover)
+HOST_EXTERN(gpio_set_input_enabled)
+HOST_EXTERN(gpio_set_input_hysteresis_enabled)
+HOST_EXTERN(gpio_set_irq_callback)
+HOST_EXTERN(gpio_set_irq_enabled)
+HOST_EXTERN(gpio_set_irq_enabled_with_callback)
+HOST_EXTERN(gpio_set_irqover)
+HOST_EXTERN(gpio_set_mask)
+HOST_EXTERN(gpio_set_oeover)
+HOST_EXTERN(gpio_set_outover)
+HOST_EXTERN(gpio_set_pulls)
+HOST_EXTERN(gpio_set_slew_rate)
+HOST_EXTERN(gpio_xor_mask)
+HOST_EXTERN(i2c_deinit)
+HOST_EXTERN(i2c_get_dreq)
+HOST_EXTERN(i2c_get_hw)
+HOST_EXTERN(i2c_get_read_available)
+HOST_EXTERN(i2c_get_write_available)
+HOST_EXTERN(i2c_hw_index)
+HOST_EXTERN(i2c_init)
+HOST_EXTERN(i2c_read_blocking)
+HOST_EXTERN(i2c_read_raw_blocking)
+HOST_EXTERN(i2c_read_timeout_per_char_us)
+HOST_EXTERN(i2c_read_timeout_us)
+HOST_EXTERN(i2c_set_baudrate)
+HOST_EXTERN(i2c_set_slave_mode)
+HOST_EXTERN(i2c_write_blocking)
+HOST_EXTERN(i2c_write_raw_blocking)
+HOST_EXTERN(i2c_write_timeout_per_char_us)
+HOST_EXTERN(i2c_write_timeout_us)
+HOST_EXTERN(irq_add_shared_handler)
+HOST_EXTERN(irq_clear)
+HOST_EXTERN(irq_get_exclusive_handler)
+HOST_EXTERN(irq_get_priority)
+HOST_EXTERN(irq_get_vtable_handler)
+HOST_EXTERN(irq_has_shared_handler)
+HOST_EXTERN(irq_init_priorities)
+HOST_EXTERN(irq_is_enabled)
+HOST_EXTERN(irq_remove_handler)
+HOST_EXTERN(irq_set_enabled)
+HOST_EXTERN(irq_set_exclusive_handler)
+HOST_EXTERN(irq_set_mask_enabled)
+HOST_EXTERN(irq_set_pending)
+HOST_EXTERN(irq_set_priority)
+HOST_EXTERN(pwm_advance_count)
+HOST_EXTERN(pwm_clear_irq)
+HOST_EXTERN(pwm_config_set_clkdiv)
+HOST_EXTERN(pwm_config_set_clkdiv_int)
+HOST_EXTERN(pwm_config_set_clkdiv_int_frac)
+HOST_EXTERN(pwm_config_set_clkdiv_mode)
+HOST_EXTERN(pwm_config_set_output_polarity)
+HOST_EXTERN(pwm_config_set_phase_correct)
+HOST_EXTERN(pwm_config_set_wrap)
+HOST_EXTERN(pwm_force_irq)
+HOST_EXTERN(pwm_get_counter)
+HOST_EXTERN(pwm_get_default_config)
+HOST_EXTERN(pwm_get_dreq)
+HOST_EXTERN(pwm_get_irq_status_mask)
+HOST_EXTERN(pwm_gpio_to_channel)
+HOST_EXTERN(pwm_gpio_to_slice_num)
+HOST_EXTERN(pwm_init)
+HOST_EXTERN(pwm_retard_count)
+HOST_EXTERN(pwm_set_both_levels)
+HOST_EXTERN(pwm_set_chan_level)
+HOST_EXTERN(pwm_set_clkdiv)
+HOST_EXTERN(pwm_set_clkdiv_int_frac)
+HOST_EXTERN(pwm_set_clkdiv_mode)
+HOST_EXTERN(pwm_set_counter)
+HOST_EXTERN(pwm_set_enabled)
+HOST_EXTERN(pwm_set_gpio_level)
+HOST_EXTERN(pwm_set_irq_enabled)
+HOST_EXTERN(pwm_set_irq_mask_enabled)
+HOST_EXTERN(pwm_set_mask_enabled)
+HOST_EXTERN(pwm_set_output_polarity)
+HOST_EXTERN(pwm_set_phase_correct)
+HOST_EXTERN(pwm_set_wrap)
+HOST_EXTERN(sleep_ms)
+HOST_EXTERN(sleep_us)
+HOST_EXTERN(spi_deinit)
+HOST_EXTERN(spi_get_baudrate)
+HOST_EXTERN(spi_get_const_hw)
+HOST_EXTERN(spi_get_dreq)
+HOST_EXTERN(spi_get_hw)
+HOST_EXTERN(spi_get_index)
+HOST_EXTERN(spi_init)
+HOST_EXTERN(spi_is_busy)
+HOST_EXTERN(spi_is_readable)
+HOST_EXTERN(spi_is_writable)
+HOST_EXTERN(spi_read16_blocking)
+HOST_EXTERN(spi_read_blocking)
+HOST_EXTERN(spi_set_baudrate)
+HOST_EXTERN(spi_set_format)
+HOST_EXTERN(spi_set_slave)
+HOST_EXTERN(spi_write16_blocking)
+HOST_EXTERN(spi_write16_read16_blocking)
+HOST_EXTERN(spi_write_blocking)
+HOST_EXTERN(spi_write_read_blocking)
+HOST_EXTERN(time_us_32)
+HOST_EXTERN(user_irq_claim)
+HOST_EXTERN(user_irq_claim_unused)
+HOST_EXTERN(user_irq_is_claimed)
+HOST_EXTERN(user_irq_unclaim)
+HOST_EXTERN(__wrap___aeabi_idiv)
+HOST_EXTERN(__wrap___aeabi_i2f)
+HOST_EXTERN(__wrap___aeabi_f2iz)
+HOST_EXTERN(__wrap___aeabi_fadd)
+HOST_EXTERN(__wrap___aeabi_fsub)
+HOST_EXTERN(__wrap___aeabi_fmul)
+HOST_EXTERN(__wrap___aeabi_fdiv)
+HOST_EXTERN(__wrap___aeabi_fcmple)
+HOST_EXTERN(__wrap___aeabi_fcmpgt)
+HOST_EXTERN(__wrap___aeabi_fcmplt)
+HOST_EXTERN(__wrap___aeabi_fcmpge)
@@ -0,0 +1,17 @@
+// Host replacement for misc/io.h: the fs_ calls used by the compiler
+// are mapped onto stdio.
+#ifndef _HAL_
+#define _HAL_
+
+#include "lfs.h"
+
+int fs_file_open(lfs_file_t* file, const char* path, int flags);
+int fs_file_close(lfs_file_t* file);
+lfs_ssize_t fs_file_read(lfs_file_t* file, void* buffer, lfs_size_t size);
+lfs_ssize_t fs_file_write(lfs_file_t* file, const void* buffer, lfs_size_t size);
+lfs_soff_t fs_file_seek(lfs_file_t* file, lfs_soff_t off, int whence);
+int fs_dir_close(lfs_dir_t* dir);
+lfs_ssize_t fs_getattr(const char* path, uint8_t type, void* buffer, lfs_size_t size);
+int fs_setattr(const char* path, uint8_t type, const void* buffer, lfs_size_t size);
+
+#endif
@@ -0,0 +1,43 @@
+// Host stand-in for littlefs: files are plain stdio streams.
+#ifndef _LFS_HOST_H_
+#define _LFS_HOST_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint32_t lfs_size_t;
+typedef uint32_t lfs_off_t;
+typedef int32_t lfs_ssize_t;
+typedef int32_t lfs_soff_t;
+
+typedef struct {
+    FILE* fp;
+} lfs_file_t;
+
+typedef struct {
+    void* dp;
+} lfs_dir_t;
+
+struct lfs_info {
+    uint8_t type;
+    lfs_size_t size;
+    char name[256];
+};
+
+enum { LFS_TYPE_REG = 1, LFS_TYPE_DIR = 2 };
+enum { LFS_ERR_OK = 0, LFS_ERR_IO = -5, LFS_ERR_NOENT = -2 };
+enum {
+    LFS_O_RDONLY = 1,
+    LFS_O_WRONLY = 2,
+    LFS_O_RDWR = 3,
+    LFS_O_CREAT = 0x0100,
+    LFS_O_EXCL = 0x0200,
+    LFS_O_TRUNC = 0x0400,
+    LFS_O_APPEND = 0x0800,
+};
+enum { LFS_SEEK_SET = 0, LFS_SEEK_CUR = 1, LFS_SEEK_END = 2 };
+
+#endif
@@ -0,0 +1,129 @@
+// Host stand-ins for the pico SDK declarations referenced by the compiler.
+// Only names and constant values matter; none of these are ever called.
+#ifndef _PICO_HOST_H_
+#define _PICO_HOST_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define __not_in_flash_func(f) f
+
+#define PICO_ERROR_TIMEOUT -1
+#define PICO_DEFAULT_LED_PIN 25
+
+// gpio
+enum gpio_function {
+    GPIO_FUNC_XIP = 0,
+    GPIO_FUNC_SPI = 1,
+    GPIO_FUNC_UART = 2,
+    GPIO_FUNC_I2C = 3,
+    GPIO_FUNC_PWM = 4,
+    GPIO_FUNC_SIO = 5,
+    GPIO_FUNC_PIO0 = 6,
+    GPIO_FUNC_PIO1 = 7,
+    GPIO_FUNC_GPCK = 8,
+    GPIO_FUNC_USB = 9,
+    GPIO_FUNC_NULL = 0x1f,
+};
+#define GPIO_OUT 1
+#define GPIO_IN 0
+enum gpio_irq_level {
+    GPIO_IRQ_LEVEL_LOW = 0x1u,
+    GPIO_IRQ_LEVEL_HIGH = 0x2u,
+    GPIO_IRQ_EDGE_FALL = 0x4u,
+    GPIO_IRQ_EDGE_RISE = 0x8u,
+};
+enum gpio_override {
+    GPIO_OVERRIDE_NORMAL = 0,
+    GPIO_OVERRIDE_INVERT = 1,
+    GPIO_OVERRIDE_LOW = 2,
+    GPIO_OVERRIDE_HIGH = 3,
+};
+enum gpio_slew_rate { GPIO_SLEW_RATE_SLOW = 0, GPIO_SLEW_RATE_FAST = 1 };
+enum gpio_drive_strength {
+    GPIO_DRIVE_STRENGTH_2MA = 0,
+    GPIO_DRIVE_STRENGTH_4MA = 1,
+    GPIO_DRIVE_STRENGTH_8MA = 2,
+    GPIO_DRIVE_STRENGTH_12MA = 3
+};
+
+// pwm
+enum pwm_clkdiv_mode {
+    PWM_DIV_FREE_RUNNING,
+    PWM_DIV_B_HIGH,
+    PWM_DIV_B_RISING,
+    PWM_DIV_B_FALLING
+};
+enum pwm_chan { PWM_CHAN_A = 0, PWM_CHAN_B = 1 };
+
+// clocks
+#define KHZ 1000
+#define MHZ 1000000
+enum clock_index {
+    clk_gpout0 = 0,
+    clk_gpout1,
+    clk_gpout2,
+    clk_gpout3,
+    clk_ref,
+    clk_sys,
+    clk_peri,
+    clk_usb,
+    clk_adc,
+    clk_rtc,
+    CLK_COUNT
+};
+
+// i2c and spi instances. The i2c instances live in firmware RAM so their
+// addresses depend on the firmware build; the host uses fixed placeholders.
+#define i2c0_inst (*(char*)0x20000000)
+#define i2c1_inst (*(char*)0x20000008)
+#define PICO_DEFAULT_I2C_INSTANCE (&i2c0_inst)
+#define spi0_hw ((void*)0x4003c000)
+#define spi1_hw ((void*)0x40040000)
+#define PICO_DEFAULT_SPI_INSTANCE spi0_hw
+
+// irq
+enum irq_num {
+    TIMER_IRQ_0,
+    TIMER_IRQ_1,
+    TIMER_IRQ_2,
+    TIMER_IRQ_3,
+    PWM_IRQ_WRAP,
+    USBCTRL_IRQ,
+    XIP_IRQ,
+    PIO0_IRQ_0,
+    PIO0_IRQ_1,
+    PIO1_IRQ_0,
+    PIO1_IRQ_1,
+    DMA_IRQ_0,
+    DMA_IRQ_1,
+    IO_IRQ_BANK0,
+    IO_IRQ_QSPI,
+    SIO_IRQ_PROC0,
+    SIO_IRQ_PROC1,
+    CLOCKS_IRQ,
+    SPI0_IRQ,
+    SPI1_IRQ,
+    UART0_IRQ,
+    UART1_IRQ,
+    ADC_IRQ_FIFO,
+    I2C0_IRQ,
+    I2C1_IRQ,
+    RTC_IRQ
+};
+#define PICO_DEFAULT_IRQ_PRIORITY 0x80
+#define PICO_LOWEST_IRQ_PRIORITY 0xc0
+#define PICO_HIGHEST_IRQ_PRIORITY 0x00
+#define PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY 0x80
+#define PICO_SHARED_IRQ_HANDLER_HIGHEST_ORDER_PRIORITY 0xff
+#define PICO_SHARED_IRQ_HANDLER_LOWEST_ORDER_PRIORITY 0x00
+
+// SDK and pshell functions taken by address in the externs table
+#define HOST_EXTERN(f) void f();
+#include "host_externs.h"
+#undef HOST_EXTERN
+
+#endif
@@ -2,6 +2,7 @@
 #include "xmodem.h"
 #include "ymodem.h"
 #include "main.h"
+#include "cc.h"
 #include <stdio.h>
 #include "hardware/timer.h"
 
@@ -17,6 +18,21 @@ static int xmodem_tx_cb(uint8_t* buf, uint32_t len) {
     return fs_file_read(&file, buf, len);
 }
 
+// executables compiled on a workstation arrive without the exe attribute,
+// restore it when the file is laid out as its executable header describes
+static void mark_exe(const char* name) {
+    struct exe_s hdr;
+    if (fs_file_open(&file, name, LFS_O_RDONLY) < LFS_ERR_OK) {
+        return;
+    }
+    int n = fs_file_read(&file, &hdr, sizeof(hdr));
+    int len = fs_file_size(&file);
+    fs_file_close(&file);
+    if (n == sizeof(hdr) && cc_exe_valid(&hdr, len)) {
+        fs_setattr(name, 1, "exe", 4);
+    }
+}
+
 uint8_t xget_cmd(void) {
     if (bad_mount(true)) {
         return 1;
@@ -53,6 +69,7 @@ uint8_t xput_cmd(void) {
     busy_wait_ms(3000);
     sprintf(sh_message, "\nfile transfered, size: %d", fs_file_seek(&file, 0, LFS_SEEK_END));
     fs_file_close(&file);
+    mark_exe(full_path(sh_argv[1]));
     return 0;
 }
 
@@ -103,6 +120,7 @@ uint8_t yput_cmd(void) {
     if (res >= 0) {
         sprintf(sh_message, "\nfile transfered, size: %d", fs_file_seek(&file, 0, LFS_SEEK_END));
         fs_rename(tmpname, full_path(name));
+        mark_exe(full_path(name));
     } else {
         strcpy(sh_message, "File transfer failed");
         fs_remove(tmpname);
@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+#
+# bench.py: code size and cycle report against a stored baseline
+#
+#   bench.py [-j jobs] [-B build-host] [-b baseline] [-a] [--save]
+#
+# Compiles every program in c-examples/ and tests/passed/ with cc_host and
+# runs it with ccsim, recording text and data size, literal pool bytes,
+# relocation count and the cycles executed. Programs needing the pico's
+# hardware stop at their first unsupported call, their cycles count up to
+# there. Each program differing from the baseline is listed with its deltas,
+# -a lists them all. --save stores the results as the new baseline.
+
+import argparse
+import concurrent.futures
+import os
+import sys
+import tempfile
+import time
+
+from run_tests import ROOT, Result, compile_exe, simulate
+
+INSN_LIMIT = 100000000  # instructions before a run is stopped
+FIELDS = ("text", "data", "pool", "reloc", "cycles")
+
+
+def measure(build, tmp, src):
+    r = Result(src)
+    exe = os.path.join(tmp, os.path.relpath(src, ROOT).replace(os.sep, "_"))
+    if compile_exe(build, src, exe, r):
+        simulate(build, exe, r, INSN_LIMIT)
+    return r
+
+
+def read_baseline(fn):
+    # one line per program: path text data pool reloc cycles
+    base = {}
+    if os.path.exists(fn):
+        with open(fn) as f:
+            for line in f:
+                if line.startswith("#") or not line.strip():
+                    continue
+                w = line.split()
+                base[w[0]] = dict(zip(FIELDS, map(int, w[1:])))
+    return base
+
+
+def write_baseline(fn, rows):
+    with open(fn, "w") as f:
+        f.write("# bench.py baseline: program %s\n" % " ".join(FIELDS))
+        for name, v in rows.items():
+            f.write("%s %s\n" % (name, " ".join(str(v[k]) for k in FIELDS)))
+
+
+def delta(new, old):
+    if old is None:
+        return "%d" % new
+    if new == old:
+        return "%d" % new
+    return "%d (%+d)" % (new, new - old)
+
+
+def main():
+    ap = argparse.ArgumentParser(description="code size and cycle report")
+    ap.add_argument("-j", "--jobs", type=int, default=os.cpu_count())
+    ap.add_argument("-B", "--build", default=os.path.join(ROOT, "build-host"),
+                    help="directory holding cc_host and ccsim")
+    ap.add_argument("-b", "--baseline", default=os.path.join(ROOT, "test-driver", "bench.baseline"))
+    ap.add_argument("-a", "--all", action="store_true", help="list unchanged programs too")
+    ap.add_argument("--save", action="store_true", help="store the results as the baseline")
+    args = ap.parse_args()
+
+    srcs = []
+    for d in ("c-examples", os.path.join("tests", "passed")):
+        srcs += sorted(os.path.join(ROOT, d, f) for f in os.listdir(os.path.join(ROOT, d))
+                       if f.endswith(".c"))
+    for tool in ("cc_host", "ccsim"):
+        if not os.access(os.path.join(args.build, tool), os.X_OK):
+            sys.exit("bench: %s not found in %s, run make host" % (tool, args.build))
+
+    t = time.perf_counter()
+    with tempfile.TemporaryDirectory() as tmp:
+        with concurrent.futures.ThreadPoolExecutor(args.jobs) as pool:
+            results = list(pool.map(lambda s: measure(args.build, tmp, s), srcs))
+    elapsed = time.perf_counter() - t
+
+    rows = {}
+    for r in results:
+        if r.error.startswith("compile"):
+            print("%s: %s" % (os.path.relpath(r.src, ROOT), r.error))
+            continue
+        rows[os.path.relpath(r.src, ROOT)] = {k: getattr(r, k) for k in FIELDS}
+
+    base = read_baseline(args.baseline)
+    print("%-28s %14s %12s %12s %10s %20s" % (("program",) + FIELDS))
+    total = dict.fromkeys(FIELDS, 0)
+    total_base = dict.fromkeys(FIELDS, 0)
+    for name, v in rows.items():
+        old = base.get(name)
+        for k in FIELDS:
+            total[k] += v[k]
+            total_base[k] += old[k] if old else v[k]
+        if args.all or old != v:
+            print("%-28s %14s %12s %12s %10s %20s" %
+                  ((name,) + tuple(delta(v[k], old[k] if old else None) for k in FIELDS)))
+    for name in base:
+        if name not in rows:
+            print("%-28s missing" % name)
+    print("%-28s %14s %12s %12s %10s %20s" %
+          (("total",) + tuple(delta(total[k], total_base[k]) for k in FIELDS)))
+    for k in ("text", "cycles"):
+        if total_base[k]:
+            print("%s %+.2f%%" % (k, 100.0 * (total[k] - total_base[k]) / total_base[k]))
+    print("%d programs, %.1f s" % (len(rows), elapsed))
+
+    if args.save:
+        write_baseline(args.baseline, rows)
+        print("baseline saved to %s" % os.path.relpath(args.baseline, ROOT))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
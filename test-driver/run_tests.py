@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+#
+# run_tests.py: compile and run the test programs on the host, in parallel
+#
+#   run_tests.py [-j jobs] [-B build-host] [-v] [test.c ...]
+#
+# Every program (tests/passed/*.c by default) is compiled by cc_host and run
+# by ccsim, both built by "make host". A test passes when it compiles, exits
+# with 0 and prints the lines of its tests/expected/NAME.c.expected file,
+# except for the few programs listed in OUTPUT_DIFFERS.
+# For each test the compile time, code and data sizes, and the instructions
+# and cycles executed are reported.
+
+import argparse
+import concurrent.futures
+import difflib
+import os
+import re
+import subprocess
+import sys
+import tempfile
+import time
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+INSN_LIMIT = 2000000000  # instructions before a run is abandoned
+RUN_TIMEOUT = 120  # seconds
+
+# tests whose output is not checked, the compiler differs from C there
+OUTPUT_DIFFERS = {
+    "00174.c": "floating point constants are single precision",
+    "00188.c": "the pre-processor has no #if",
+    "00195.c": "double is not a supported type",
+}
+
+
+class Result:
+    def __init__(self, src):
+        self.src = src
+        self.name = os.path.basename(src)
+        self.ok = False
+        self.error = ""
+        self.compile_ms = 0.0
+        self.text = self.data = self.reloc = self.pool = 0
+        self.instrs = self.cycles = 0
+        self.exit = None
+        self.output = ""
+
+
+def compile_exe(build, src, exe, r):
+    # cc_host prints the segment sizes in hex once the executable is written
+    t = time.perf_counter()
+    p = subprocess.run([os.path.join(build, "cc_host"), "-o", exe, os.path.basename(src)],
+                       cwd=os.path.dirname(src), capture_output=True, text=True)
+    r.compile_ms = (time.perf_counter() - t) * 1000
+    sizes = dict(re.findall(r"^(text|data|reloc|pool) +([0-9a-f]+)$", p.stdout, re.M))
+    if p.returncode or len(sizes) != 4:
+        r.error = "compile: " + " ".join(re.sub(r"\x1b\[[0-9;]*m", "", p.stdout).split())
+        return False
+    r.text = int(sizes["text"], 16)
+    r.data = int(sizes["data"], 16)
+    r.reloc = int(sizes["reloc"], 16)
+    r.pool = int(sizes["pool"], 16)
+    return True
+
+
+def simulate(build, exe, r, limit=INSN_LIMIT):
+    # ccsim -c reports the counts on stderr, up to the error when the run fails
+    try:
+        p = subprocess.run([os.path.join(build, "ccsim"), "-c", "-l", str(limit), exe],
+                           stdin=subprocess.DEVNULL, capture_output=True, timeout=RUN_TIMEOUT)
+    except subprocess.TimeoutExpired:
+        r.error = "run: timed out"
+        return False
+    r.output = p.stdout.decode("latin-1")
+    err = p.stderr.decode("latin-1")
+    counts = dict(re.findall(r"^(instructions|cycles|exit) (-?\d+)$", err, re.M))
+    r.instrs = int(counts.get("instructions", 0))
+    r.cycles = int(counts.get("cycles", 0))
+    if "exit" not in counts:
+        r.error = "run: " + (err.splitlines() or ["no counts reported"])[0]
+        return False
+    r.exit = int(counts["exit"])
+    return True
+
+
+def expected_lines(src):
+    fn = os.path.join(ROOT, "tests", "expected", os.path.basename(src) + ".expected")
+    if not os.path.exists(fn):
+        return None
+    with open(fn, encoding="latin-1") as f:
+        return f.read().splitlines()
+
+
+def run_test(build, tmp, src):
+    r = Result(src)
+    exe = os.path.join(tmp, os.path.splitext(r.name)[0])
+    if not compile_exe(build, src, exe, r) or not simulate(build, exe, r):
+        return r
+    if r.exit != 0:
+        r.error = "exit code %d" % r.exit
+        return r
+    want = expected_lines(src)
+    got = r.output.splitlines()
+    if want is not None and got[:len(want)] != want and r.name not in OUTPUT_DIFFERS:
+        diff = difflib.unified_diff(want, got, "expected", "output", lineterm="", n=1)
+        r.error = "output differs\n" + "\n".join(list(diff)[:20])
+        return r
+    r.ok = True
+    return r
+
+
+def run_all(build, srcs, jobs):
+    # results come back in the order of srcs
+    with tempfile.TemporaryDirectory() as tmp:
+        with concurrent.futures.ThreadPoolExecutor(jobs) as pool:
+            return list(pool.map(lambda s: run_test(build, tmp, s), srcs))
+
+
+def main():
+    ap = argparse.ArgumentParser(description="run the test programs under simulation")
+    ap.add_argument("-j", "--jobs", type=int, default=os.cpu_count())
+    ap.add_argument("-B", "--build", default=os.path.join(ROOT, "build-host"),
+                    help="directory holding cc_host and ccsim")
+    ap.add_argument("-v", "--verbose", action="store_true", help="list every test")
+    ap.add_argument("tests", nargs="*", help="programs to run, tests/passed/*.c by default")
+    args = ap.parse_args()
+
+    srcs = args.tests
+    if not srcs:
+        d = os.path.join(ROOT, "tests", "passed")
+        srcs = sorted(os.path.join(d, f) for f in os.listdir(d) if f.endswith(".c"))
+    srcs = [os.path.abspath(s) for s in srcs]
+    for tool in ("cc_host", "ccsim"):
+        if not os.access(os.path.join(args.build, tool), os.X_OK):
+            sys.exit("run_tests: %s not found in %s, run make host" % (tool, args.build))
+
+    t = time.perf_counter()
+    results = run_all(args.build, srcs, args.jobs)
+    elapsed = time.perf_counter() - t
+
+    if args.verbose:
+        print("%-12s %-4s %10s %6s %6s %12s %12s" %
+              ("test", "", "compile ms", "text", "data", "instructions", "cycles"))
+    for r in results:
+        if args.verbose or not r.ok:
+            print("%-12s %-4s %10.1f %6d %6d %12d %12d" %
+                  (r.name, "ok" if r.ok else "FAIL", r.compile_ms, r.text, r.data, r.instrs,
+                   r.cycles))
+        if not r.ok:
+            print("    " + r.error.replace("\n", "\n    "))
+    failed = sum(not r.ok for r in results)
+    print("%d tests, %d failed, text %d bytes, %d cycles, %.1f s" %
+          (len(results), failed, sum(r.text for r in results), sum(r.cycles for r in results),
+           elapsed))
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
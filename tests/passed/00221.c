@@ -0,0 +1,18 @@
+#include <stdio.h>
+
+int x[8] = {-9, -8, -7, -3, -1, 0, 5, 12};
+
+int main() {
+    int i, a;
+
+    for (i = 0; i < 8; i++) {
+        a = x[i];
+        printf("%d: %d %d %d %d %d %d\n", a, a / 2, a / -2, a / 4, a / -4, a / 1, a / -1);
+        printf("%d: %d %d %d %d %d %d\n", a, a % 2, a % -2, a % 4, a % -4, a % 1, a % -1);
+        printf("%d: %d %d %d %d\n", a, a / 7, a / -7, a % 7, a % -7);
+    }
+    a = -2147483647 - 1;
+    printf("%d %d %d %d\n", a / 2, a % 2, a / 65536, a % 65536);
+
+    return 0;
+}
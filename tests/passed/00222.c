@@ -0,0 +1,22 @@
+#include <stdio.h>
+
+void compare(float a, float b) {
+    printf("%d %d %d %d %d %d\n", a < b, a <= b, a > b, a >= b, a == b, a != b);
+    if (a < b) printf("lt ");
+    if (a <= b) printf("le ");
+    if (a > b) printf("gt ");
+    if (a >= b) printf("ge ");
+    if (a == b) printf("eq ");
+    if (a != b) printf("ne ");
+    printf("\n");
+}
+
+int main() {
+    compare(1.5, 1.5);
+    compare(-2.0, 3.0);
+    compare(3.0, -2.0);
+    compare(-1.25, -1.25);
+    compare(-1.25, -1.5);
+
+    return 0;
+}
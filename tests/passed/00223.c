@@ -0,0 +1,20 @@
+#include <stdio.h>
+
+int s;
+
+int mix(int a, int b, int c, int d, int e, int f) {
+    int i;
+
+    for (i = 0; i < 20; i++) {
+        s = (s + 123456789 + e) ^ 987654321;
+    }
+    return s + a + b + c + d + e * 1000 + f * 100000;
+}
+
+int main() {
+    printf("%d\n", mix(3, 1, 2, 3, 4, 5));
+    printf("%d\n", mix(10, -1, -2, -3, -4, -5));
+    printf("%d\n", mix(0, 10, 20, 30, 40, 50));
+
+    return 0;
+}
@@ -0,0 +1,16 @@
+#include <stdio.h>
+
+int x, y;
+
+int main() {
+    int a, b;
+
+    x = 5;
+    a = 1 ? x++ : 0;
+    b = 0 ? 7 : y--;
+    printf("%d %d %d %d\n", a, b, x, y);
+    printf("%d\n", (1 ? x++ : 0) + (0 ? 1 : x--));
+    printf("%d\n", 1 ? (x = 42) : 0);
+
+    return 0;
+}
@@ -0,0 +1,137 @@
+#include <stdio.h>
+
+int u, v, w, g;
+
+int step(int x) {
+    switch (x) {
+    case 2:
+        u = v < w ? (w < g ? v : g) : (v < g ? w : u + 3); v = w > g ? v - g : g - v;
+        u = v < g ? (g < w ? v : w) : (v < w ? g : u + 4); v = g > w ? v - w : w - v;
+        u = w < v ? (v < g ? w : g) : (w < g ? v : u + 5); w = v > g ? w - g : g - w;
+        u = w < g ? (g < v ? w : v) : (w < v ? g : u + 6); w = g > v ? w - v : v - w;
+        u = g < v ? (v < w ? g : w) : (g < w ? v : u + 7); g = v > w ? g - w : w - g;
+        u = g < w ? (w < v ? g : v) : (g < v ? w : u + 3); g = w > v ? g - v : v - g;
+        v = u < w ? (w < g ? u : g) : (u < g ? w : v + 4); u = w > g ? u - g : g - u;
+        v = u < g ? (g < w ? u : w) : (u < w ? g : v + 5); u = g > w ? u - w : w - u;
+        v = w < u ? (u < g ? w : g) : (w < g ? u : v + 6); w = u > g ? w - g : g - w;
+        v = w < g ? (g < u ? w : u) : (w < u ? g : v + 7); w = g > u ? w - u : u - w;
+        v = g < u ? (u < w ? g : w) : (g < w ? u : v + 3); g = u > w ? g - w : w - g;
+        v = g < w ? (w < u ? g : u) : (g < u ? w : v + 4); g = w > u ? g - u : u - g;
+        w = u < v ? (v < g ? u : g) : (u < g ? v : w + 5); u = v > g ? u - g : g - u;
+        w = u < g ? (g < v ? u : v) : (u < v ? g : w + 6); u = g > v ? u - v : v - u;
+        w = v < u ? (u < g ? v : g) : (v < g ? u : w + 7); v = u > g ? v - g : g - v;
+        w = v < g ? (g < u ? v : u) : (v < u ? g : w + 3); v = g > u ? v - u : u - v;
+        w = g < u ? (u < v ? g : v) : (g < v ? u : w + 4); g = u > v ? g - v : v - g;
+        w = g < v ? (v < u ? g : u) : (g < u ? v : w + 5); g = v > u ? g - u : u - g;
+        g = u < v ? (v < w ? u : w) : (u < w ? v : g + 6); u = v > w ? u - w : w - u;
+        g = u < w ? (w < v ? u : v) : (u < v ? w : g + 7); u = w > v ? u - v : v - u;
+        g = v < u ? (u < w ? v : w) : (v < w ? u : g + 3); v = u > w ? v - w : w - v;
+        g = v < w ? (w < u ? v : u) : (v < u ? w : g + 4); v = w > u ? v - u : u - v;
+        g = w < u ? (u < v ? w : v) : (w < v ? u : g + 5); w = u > v ? w - v : v - w;
+        g = w < v ? (v < u ? w : u) : (w < u ? v : g + 6); w = v > u ? w - u : u - w;
+        u = v < w ? (w < g ? v : g) : (v < g ? w : u + 7); v = w > g ? v - g : g - v;
+        u = v < g ? (g < w ? v : w) : (v < w ? g : u + 3); v = g > w ? v - w : w - v;
+        u = w < v ? (v < g ? w : g) : (w < g ? v : u + 4); w = v > g ? w - g : g - w;
+        u = w < g ? (g < v ? w : v) : (w < v ? g : u + 5); w = g > v ? w - v : v - w;
+        u = g < v ? (v < w ? g : w) : (g < w ? v : u + 6); g = v > w ? g - w : w - g;
+        g = g + 1;
+        break;
+    case 3:
+        v = u < g ? (g < w ? u : w) : (u < w ? g : v + 5); u = g > w ? u - w : w - u;
+        v = w < u ? (u < g ? w : g) : (w < g ? u : v + 6); w = u > g ? w - g : g - w;
+        v = w < g ? (g < u ? w : u) : (w < u ? g : v + 7); w = g > u ? w - u : u - w;
+        v = g < u ? (u < w ? g : w) : (g < w ? u : v + 3); g = u > w ? g - w : w - g;
+        v = g < w ? (w < u ? g : u) : (g < u ? w : v + 4); g = w > u ? g - u : u - g;
+        w = u < v ? (v < g ? u : g) : (u < g ? v : w + 5); u = v > g ? u - g : g - u;
+        w = u < g ? (g < v ? u : v) : (u < v ? g : w + 6); u = g > v ? u - v : v - u;
+        w = v < u ? (u < g ? v : g) : (v < g ? u : w + 7); v = u > g ? v - g : g - v;
+        w = v < g ? (g < u ? v : u) : (v < u ? g : w + 3); v = g > u ? v - u : u - v;
+        w = g < u ? (u < v ? g : v) : (g < v ? u : w + 4); g = u > v ? g - v : v - g;
+        w = g < v ? (v < u ? g : u) : (g < u ? v : w + 5); g = v > u ? g - u : u - g;
+        g = u < v ? (v < w ? u : w) : (u < w ? v : g + 6); u = v > w ? u - w : w - u;
+        g = u < w ? (w < v ? u : v) : (u < v ? w : g + 7); u = w > v ? u - v : v - u;
+        g = v < u ? (u < w ? v : w) : (v < w ? u : g + 3); v = u > w ? v - w : w - v;
+        g = v < w ? (w < u ? v : u) : (v < u ? w : g + 4); v = w > u ? v - u : u - v;
+        g = w < u ? (u < v ? w : v) : (w < v ? u : g + 5); w = u > v ? w - v : v - w;
+        g = w < v ? (v < u ? w : u) : (w < u ? v : g + 6); w = v > u ? w - u : u - w;
+        u = v < w ? (w < g ? v : g) : (v < g ? w : u + 7); v = w > g ? v - g : g - v;
+        u = v < g ? (g < w ? v : w) : (v < w ? g : u + 3); v = g > w ? v - w : w - v;
+        u = w < v ? (v < g ? w : g) : (w < g ? v : u + 4); w = v > g ? w - g : g - w;
+        u = w < g ? (g < v ? w : v) : (w < v ? g : u + 5); w = g > v ? w - v : v - w;
+        u = g < v ? (v < w ? g : w) : (g < w ? v : u + 6); g = v > w ? g - w : w - g;
+        u = g < w ? (w < v ? g : v) : (g < v ? w : u + 7); g = w > v ? g - v : v - g;
+        v = u < w ? (w < g ? u : g) : (u < g ? w : v + 3); u = w > g ? u - g : g - u;
+        v = u < g ? (g < w ? u : w) : (u < w ? g : v + 4); u = g > w ? u - w : w - u;
+        v = w < u ? (u < g ? w : g) : (w < g ? u : v + 5); w = u > g ? w - g : g - w;
+        v = w < g ? (g < u ? w : u) : (w < u ? g : v + 6); w = g > u ? w - u : u - w;
+        v = g < u ? (u < w ? g : w) : (g < w ? u : v + 7); g = u > w ? g - w : w - g;
+        v = g < w ? (w < u ? g : u) : (g < u ? w : v + 3); g = w > u ? g - u : u - g;
+        w = u < v ? (v < g ? u : g) : (u < g ? v : w + 4); u = v > g ? u - g : g - u;
+        w = u < g ? (g < v ? u : v) : (u < v ? g : w + 5); u = g > v ? u - v : v - u;
+        w = v < u ? (u < g ? v : g) : (v < g ? u : w + 6); v = u > g ? v - g : g - v;
+        w = v < g ? (g < u ? v : u) : (v < u ? g : w + 7); v = g > u ? v - u : u - v;
+        w = g < u ? (u < v ? g : v) : (g < v ? u : w + 3); g = u > v ? g - v : v - g;
+        w = g < v ? (v < u ? g : u) : (g < u ? v : w + 4); g = v > u ? g - u : u - g;
+        g = u < v ? (v < w ? u : w) : (u < w ? v : g + 5); u = v > w ? u - w : w - u;
+        g = u < w ? (w < v ? u : v) : (u < v ? w : g + 6); u = w > v ? u - v : v - u;
+        g = v < u ? (u < w ? v : w) : (v < w ? u : g + 7); v = u > w ? v - w : w - v;
+        g = v < w ? (w < u ? v : u) : (v < u ? w : g + 3); v = w > u ? v - u : u - v;
+        g = w < u ? (u < v ? w : v) : (w < v ? u : g + 4); w = u > v ? w - v : v - w;
+        g = w < v ? (v < u ? w : u) : (w < u ? v : g + 5); w = v > u ? w - u : u - w;
+        u = v < w ? (w < g ? v : g) : (v < g ? w : u + 6); v = w > g ? v - g : g - v;
+        u = v < g ? (g < w ? v : w) : (v < w ? g : u + 7); v = g > w ? v - w : w - v;
+        u = w < v ? (v < g ? w : g) : (w < g ? v : u + 3); w = v > g ? w - g : g - w;
+        u = w < g ? (g < v ? w : v) : (w < v ? g : u + 4); w = g > v ? w - v : v - w;
+        u = g < v ? (v < w ? g : w) : (g < w ? v : u + 5); g = v > w ? g - w : w - g;
+        u = g < w ? (w < v ? g : v) : (g < v ? w : u + 6); g = w > v ? g - v : v - g;
+        v = u < w ? (w < g ? u : g) : (u < g ? w : v + 7); u = w > g ? u - g : g - u;
+        v = u < g ? (g < w ? u : w) : (u < w ? g : v + 3); u = g > w ? u - w : w - u;
+        v = w < u ? (u < g ? w : g) : (w < g ? u : v + 4); w = u > g ? w - g : g - w;
+        v = w < g ? (g < u ? w : u) : (w < u ? g : v + 5); w = g > u ? w - u : u - w;
+        v = g < u ? (u < w ? g : w) : (g < w ? u : v + 6); g = u > w ? g - w : w - g;
+        v = g < w ? (w < u ? g : u) : (g < u ? w : v + 7); g = w > u ? g - u : u - g;
+        w = u < v ? (v < g ? u : g) : (u < g ? v : w + 3); u = v > g ? u - g : g - u;
+        w = u < g ? (g < v ? u : v) : (u < v ? g : w + 4); u = g > v ? u - v : v - u;
+        w = v < u ? (u < g ? v : g) : (v < g ? u : w + 5); v = u > g ? v - g : g - v;
+        w = v < g ? (g < u ? v : u) : (v < u ? g : w + 6); v = g > u ? v - u : u - v;
+        w = g < u ? (u < v ? g : v) : (g < v ? u : w + 7); g = u > v ? g - v : v - g;
+        w = g < v ? (v < u ? g : u) : (g < u ? v : w + 3); g = v > u ? g - u : u - g;
+        g = u < v ? (v < w ? u : w) : (u < w ? v : g + 4); u = v > w ? u - w : w - u;
+        g = u < w ? (w < v ? u : v) : (u < v ? w : g + 5); u = w > v ? u - v : v - u;
+        g = v < u ? (u < w ? v : w) : (v < w ? u : g + 6); v = u > w ? v - w : w - v;
+        g = v < w ? (w < u ? v : u) : (v < u ? w : g + 7); v = w > u ? v - u : u - v;
+        g = w < u ? (u < v ? w : v) : (w < v ? u : g + 3); w = u > v ? w - v : v - w;
+        g = w < v ? (v < u ? w : u) : (w < u ? v : g + 4); w = v > u ? w - u : u - w;
+        u = v < w ? (w < g ? v : g) : (v < g ? w : u + 5); v = w > g ? v - g : g - v;
+        u = v < g ? (g < w ? v : w) : (v < w ? g : u + 6); v = g > w ? v - w : w - v;
+        u = w < v ? (v < g ? w : g) : (w < g ? v : u + 7); w = v > g ? w - g : g - w;
+        u = w < g ? (g < v ? w : v) : (w < v ? g : u + 3); w = g > v ? w - v : v - w;
+        g = g + 1;
+        u = u ^ v;
+        w = w - g;
+        v = v + 2;
+        g = g ^ w;
+        u = u + 3;
+        g = g + 7;
+        break;
+    case 0: g = u + v; break;
+    case 1: g = v - w; break;
+    case 4: g = w * 3; break;
+    case 5: g = u ^ w; break;
+    default: g = -1; break;
+    }
+    return g;
+}
+
+int main() {
+    int i;
+    for (i = -1; i < 8; ++i) {
+        u = i * 7 - 3;
+        v = 11 - i * 5;
+        w = i * i - 9;
+        g = i;
+        step(i);
+        printf("%d %d %d %d %d\n", i, u, v, w, g);
+    }
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include <stdio.h>
+
+int sum(int n, int acc) {
+    if (n == 0)
+        return acc;
+    return sum(n - 1, (acc + n) % 1000003);
+}
+
+int gcd(int a, int b) {
+    if (b == 0)
+        return a;
+    return gcd(b, a % b);
+}
+
+int swap(int a, int b, int n) {
+    if (n == 0)
+        return a * 100 + b;
+    return swap(b, a, n - 1);
+}
+
+int rot(int a, int b, int c, int n) {
+    if (n == 0)
+        return a * 100 + b * 10 + c;
+    return rot(b, c, a, n - 1);
+}
+
+int pair(int a, int b) {
+    if (a < 0)
+        a = -a;
+    if (b < 0)
+        b = -b;
+    return a * 1000 + b % 1000;
+}
+
+int flip(int a, int b) {
+    if (a < b)
+        return pair(b, a);
+    return pair(a - b, b * 2);
+}
+
+int six(int a, int b, int c, int d, int e, int f) {
+    if (a == 0)
+        return b + c * 10 + d * 100 + e * 1000 + f * 10000;
+    return six(a - 1, c, d, e, f, b);
+}
+
+int mix(int a, int b, int c, int d, int e, int f) {
+    return pair(f - a, e + b * c - d);
+}
+
+int main() {
+    int i, s;
+    printf("%d\n", sum(100000, 0));
+    printf("%d\n", gcd(1071, 462));
+    printf("%d %d\n", swap(1, 2, 5), swap(1, 2, 100000));
+    printf("%d %d\n", rot(1, 2, 3, 4), rot(1, 2, 3, 100000));
+    printf("%d %d\n", flip(3, 4), flip(9, 2));
+    printf("%d\n", six(7, 1, 2, 3, 4, 5));
+    s = 0;
+    for (i = 0; i < 100000; ++i)
+        s = (s + mix(i, 2, 3, 4, 5, i % 7)) % 1000003;
+    printf("%d\n", s);
+    return 0;
+}